@@ -5,6 +5,17 @@
 #include "services/clock.hpp"
 #include "services/client.hpp"
 #include "services/queue.hpp"
+#include "services/broadcast.hpp"
+#include "services/file_cache.hpp"
+#include "services/watcher.hpp"
+#include "services/fd_cache.hpp"
+#include "services/negative_cache.hpp"
+#include "services/fingerprints.hpp"
+#include "services/response_cache.hpp"
+#include "asset_bundle.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <string>
 #include <boost/asio.hpp>
@@ -20,11 +31,66 @@ public:
     std::shared_ptr<Client> get_client() const;
     std::shared_ptr<Queue> get_queue() const;
     std::shared_ptr<Log> get_log() const;
+    std::shared_ptr<Broadcast> get_broadcast() const;
+    std::shared_ptr<FileCache> get_file_cache() const;
+    std::shared_ptr<Watcher> get_watcher() const;
+    std::shared_ptr<FdCache> get_fd_cache() const;
+    std::shared_ptr<NegativeCache> get_negative_cache() const;
+    std::shared_ptr<Fingerprints> get_fingerprints() const;
+    std::shared_ptr<ResponseCache> get_response_cache() const;
+
+    // Watch the whole document root so the file caches are invalidated as
+    // soon as anything under it changes, and only revalidate on a timer as
+    // a fallback. With prewarm, files small enough for the FileCache are
+    // loaded up front and again whenever they are rewritten.
+    void watch_doc_root(const std::string& doc_root, bool prewarm);
+
+    // Serve every file under doc_root at a URL containing a hash of its
+    // contents as well, cacheable forever, and rewrite references in pages
+    // to use them. The hashes follow changes reported by the Watcher.
+    void fingerprint_doc_root(const std::string& doc_root);
+
+    // Serve the assets packed in a bundle ahead of doc_root. The bundle is
+    // swapped for the new one whenever the file is replaced. Returns false
+    // if it cannot be loaded.
+    bool load_bundle(const std::string& path);
+
+    // The current bundle, or nullptr
+    std::shared_ptr<asset_bundle const> get_bundle() const;
+
+    // Graceful shutdown: once draining, every response carries Connection: close
+    void begin_drain();
+    bool draining() const;
+
+    // Track requests between being read and their response being written
+    void request_started();
+    void request_finished();
+
+    // Invoke on_drained once the Queue is idle and no request is in flight,
+    // or when the deadline passes, whichever comes first.
+    void wait_for_drain(std::chrono::milliseconds deadline, std::function<void()> on_drained);
 private:
+    void poll_drain(std::chrono::steady_clock::time_point deadline, std::function<void()> on_drained);
+
+    // Refresh the cached Date header at the start of every second
+    void tick_date();
+
     std::shared_ptr<Clock> clock_;
     std::shared_ptr<Client> client_;
     std::shared_ptr<Queue> queue_;
     std::shared_ptr<Log> log_;
+    std::shared_ptr<Broadcast> broadcast_;
+    std::shared_ptr<FileCache> file_cache_;
+    std::shared_ptr<asset_bundle const> bundle_; // outlives the watcher thread
+    std::shared_ptr<Watcher> watcher_;
+    std::shared_ptr<FdCache> fd_cache_;
+    std::shared_ptr<NegativeCache> negative_cache_;
+    std::shared_ptr<Fingerprints> fingerprints_;
+    std::shared_ptr<ResponseCache> response_cache_;
+    std::atomic<bool> draining_{false};
+    std::atomic<std::size_t> in_flight_{0};
+    boost::asio::steady_timer drain_timer_;
+    boost::asio::steady_timer date_timer_;
 };
 
 #endif // APPLICATION_HPP
@@ -0,0 +1,95 @@
+#ifndef ASSET_BUNDLE_HPP
+#define ASSET_BUNDLE_HPP
+
+#include "mapped_file.hpp"
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// A whole document root packed into one file by tools/pack_bundle.cpp.
+// Everything a response needs is computed when the bundle is built: the
+// content type, ETag and Last-Modified of each file, and a gzip variant
+// of those worth compressing. The server maps the bundle once and serves
+// every asset as a slice of that mapping, so a request for a bundled file
+// makes no file syscalls. Replacing the bundle replaces the whole site at
+// once.
+//
+// Layout, in host byte order:
+//
+//     header
+//     record[count]           sorted by path
+//     strings and contents    referred to by offset from the start
+//
+namespace bundle_format {
+
+constexpr char magic[8] = {'W', 'W', 'W', 'P', 'A', 'C', 'K', '1'};
+
+struct span
+{
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+struct header
+{
+    char magic[8];
+    std::uint64_t count;
+};
+
+struct record
+{
+    span path;          // URL path, e.g. "/css/site.css"
+    span content_type;
+    span etag;
+    span gzip_etag;
+    span last_modified; // HTTP-date
+    span data;
+    span gzip;          // empty when not worth compressing
+    std::int64_t mtime; // nanoseconds since the epoch
+};
+
+static_assert(std::is_trivially_copyable<header>::value && sizeof(header) == 16, "bundle header layout");
+static_assert(std::is_trivially_copyable<record>::value && sizeof(record) == 120, "bundle record layout");
+
+} // namespace bundle_format
+
+class asset_bundle
+{
+public:
+    // A bundled file; views into the mapping, valid while the bundle is
+    struct asset
+    {
+        std::string_view path;
+        std::string_view content_type;
+        std::string_view etag;
+        std::string_view gzip_etag;
+        std::string_view last_modified;
+        std::string_view data;
+        std::string_view gzip;
+        std::int64_t mtime;
+    };
+
+    // Map and validate a bundle. Returns nullptr, after logging why, if it
+    // cannot be read or is malformed.
+    static std::shared_ptr<asset_bundle const> open(std::string const& path);
+
+    // Binary search of the path table
+    boost::optional<asset> find(std::string_view path) const;
+
+    std::size_t size() const { return count_; }
+
+    explicit asset_bundle(std::shared_ptr<mapped_file const> file);
+
+private:
+    std::string_view view(bundle_format::span const& s) const;
+    asset at(std::size_t index) const;
+
+    std::shared_ptr<mapped_file const> file_;
+    bundle_format::record const* records_ = nullptr;
+    std::size_t count_ = 0;
+};
+
+#endif // ASSET_BUNDLE_HPP
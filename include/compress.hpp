@@ -0,0 +1,20 @@
+#ifndef COMPRESS_HPP
+#define COMPRESS_HPP
+
+#include "beast.hpp"
+#include <cstddef>
+#include <string>
+
+// Bodies smaller than this are sent as they are; the gzip framing and the
+// CPU time outweigh the savings.
+constexpr std::size_t compress_min_size = 1024;
+
+// Returns true for content types that compress well (text, JSON, XML,
+// JavaScript, SVG).
+bool compressible(beast::string_view content_type);
+
+// Encode data in gzip format with zlib. Throws std::runtime_error if zlib
+// reports an error.
+std::string gzip_compress(beast::string_view data, int level = 6);
+
+#endif // COMPRESS_HPP
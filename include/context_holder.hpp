@@ -0,0 +1,46 @@
+#ifndef CONTEXT_HOLDER_HPP
+#define CONTEXT_HOLDER_HPP
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Holds the SSL context used for new handshakes and allows it to be
+// replaced while the server is running. Sessions keep a reference to the
+// context they were accepted with, so a reload only affects connections
+// accepted after the swap. When SNI_CONFIG names a virtual host file the
+// contexts for those hosts are rebuilt along with the default one.
+class context_holder : public std::enable_shared_from_this<context_holder>
+{
+    std::shared_ptr<boost::asio::ssl::context> ctx_;
+    boost::asio::steady_timer timer_;
+    std::vector<std::string> files_;
+    std::vector<std::filesystem::file_time_type> mtimes_;
+    bool changed_ = false;
+public:
+    // Builds the initial context; throws if the certificate cannot be loaded.
+    explicit context_holder(boost::asio::io_context& ioc);
+
+    // The context for the next handshake.
+    std::shared_ptr<boost::asio::ssl::context> get() const;
+
+    // Build a new context from the certificate files and swap it in.
+    // On failure the current context is kept and false is returned.
+    bool reload();
+
+    // Run reload() on a background thread so no I/O thread pays for it.
+    void reload_async();
+
+    // Poll the certificate files and reload when any of them changes.
+    void watch(std::chrono::seconds interval);
+
+private:
+    static std::shared_ptr<boost::asio::ssl::context> build();
+    bool files_changed();
+};
+
+#endif // CONTEXT_HOLDER_HPP
@@ -0,0 +1,138 @@
+#ifndef HEADER_POLICY_HPP
+#define HEADER_POLICY_HPP
+
+#include "beast.hpp"
+#include "response_headers.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Response headers attached by request path: caching, CORS and security
+// headers. The configuration file has one header per line:
+//
+//     # pattern        header
+//     *                X-Content-Type-Options: nosniff
+//     /assets/         Cache-Control: public, max-age=86400
+//     /fonts/*.woff2   Access-Control-Allow-Origin: *
+//     /api/*           Cache-Control: no-store
+//     /robots.txt      Cache-Control: public, max-age=3600
+//
+// A pattern ending in '/' or '*' matches every path below it, one with a
+// '*' elsewhere matches paths that start with the text before the '*' and
+// end with the text after it, and any other pattern matches that path
+// only. Every matching line applies, in file order, so a later line
+// replaces a header set by an earlier one. Vary is the exception: its
+// tokens are added to those already on the response, since the handler
+// may have varied it by Accept-Encoding.
+//
+// Cache-Control and Expires are only sent on successful and 304 responses,
+// so an error is never cached under a long-lived rule.
+//
+// Patterns are compiled into a trie over their literal prefixes; a lookup
+// walks the path once. Header names are resolved and values copied once
+// at load time, so applying a rule formats nothing.
+class header_policy
+{
+public:
+    struct header
+    {
+        http::field field;  // http::field::unknown for custom names
+        std::string name;
+        std::string value;
+        bool caching;       // Cache-Control or Expires
+    };
+
+    // Load every rule in the file; throws on any error.
+    static std::shared_ptr<header_policy> load(std::string const& path);
+
+    // Add a rule; the file format without the file.
+    void add(std::string const& pattern, std::string const& name, std::string const& value);
+
+    // Set the headers of every rule matching path on res. Caching headers
+    // are skipped unless cacheable.
+    template<class Fields>
+    void apply(http::header<false, Fields>& res, beast::string_view path, bool cacheable) const
+    {
+        match(path, [&](header const& h)
+        {
+            if(h.caching && ! cacheable)
+                return;
+            if(h.field == http::field::vary)
+            {
+                for(auto const& token : http::token_list{h.value})
+                    response_headers::vary(res, token);
+            }
+            else if(h.field != http::field::unknown)
+                res.set(h.field, h.value);
+            else
+                res.set(h.name, h.value);
+        });
+    }
+
+    std::size_t size() const { return rules_.size(); }
+
+private:
+    struct rule
+    {
+        enum class kind { exact, prefix, glob } type;
+        std::string suffix; // for globs, the text after the '*'
+        header h;
+    };
+
+    struct node
+    {
+        std::vector<std::pair<char, std::uint32_t>> children;
+        std::vector<std::uint32_t> rules; // indices, in file order
+    };
+
+    template<class Visit>
+    void match(beast::string_view path, Visit&& visit) const;
+
+    std::vector<rule> rules_;
+    std::vector<node> nodes_ = std::vector<node>(1);
+};
+
+template<class Visit>
+void header_policy::match(beast::string_view path, Visit&& visit) const
+{
+    // Collect the rules on the path through the trie, then apply them in
+    // file order; only a handful ever match
+    std::uint32_t found[32];
+    std::size_t count = 0;
+    auto collect = [&](node const& n, std::size_t depth)
+    {
+        for(auto index : n.rules)
+        {
+            auto const& r = rules_[index];
+            bool const matched =
+                r.type == rule::kind::prefix ||
+                (r.type == rule::kind::exact && depth == path.size()) ||
+                (r.type == rule::kind::glob && path.size() - depth >= r.suffix.size() &&
+                    path.substr(path.size() - r.suffix.size()) == r.suffix);
+            if(matched && count < sizeof(found) / sizeof(found[0]))
+                found[count++] = index;
+        }
+    };
+
+    std::uint32_t current = 0;
+    collect(nodes_[0], 0);
+    for(std::size_t i = 0; i < path.size(); ++i)
+    {
+        auto const& children = nodes_[current].children;
+        auto it = std::find_if(children.begin(), children.end(),
+            [c = path[i]](std::pair<char, std::uint32_t> const& child) { return child.first == c; });
+        if(it == children.end())
+            break;
+        current = it->second;
+        collect(nodes_[current], i + 1);
+    }
+
+    std::sort(found, found + count);
+    for(std::size_t i = 0; i < count; ++i)
+        visit(rules_[found[i]].h);
+}
+
+#endif // HEADER_POLICY_HPP
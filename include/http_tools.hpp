@@ -3,6 +3,7 @@
 #include "beast.hpp"
 #include "json.hpp"
 #include "application.hpp"
+#include "range_body.hpp"
 #include <boost/config.hpp>
 #include <boost/asio/dispatch.hpp>
 #include <boost/asio/strand.hpp>
@@ -10,6 +11,7 @@
 #include <boost/beast/http.hpp>
 #include <boost/beast/ssl.hpp>
 #include <boost/beast/version.hpp>
+#include <boost/optional.hpp>
 #include <string>
 
 namespace net = boost::asio;
@@ -18,13 +20,56 @@ using tcp = boost::asio::ip::tcp;
 using json = nlohmann::json;
 // Function declarations
 beast::string_view mime_type(beast::string_view path);
+
+// Add or override extension mappings from a mime.types file. Call before
+// the server starts handling requests.
+void load_mime_types(std::string const& path);
+// Attach the response headers configured in a header rules file; see
+// header_policy.hpp. Call before the server starts handling requests.
+void load_header_rules(std::string const& path);
 std::string path_cat(beast::string_view base, beast::string_view path);
 
+// Parse Accept-Encoding into FileCache::gzip / FileCache::brotli bits
+unsigned accepted_encodings(beast::string_view accept_encoding);
+
+// Run the request through the middleware ahead of the handlers; returns
+// a response when a middleware answers it itself.
+template <class Body, class Allocator>
+boost::optional<boost::beast::http::message_generator> intercept_request(
+    boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>>& req);
+
+// Run the middleware's response hooks over a response built outside the
+// handlers, such as the header of an event stream.
+template <class Body, class Allocator>
+void decorate_response(
+    boost::beast::http::response_header<>& res,
+    boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> const& req);
+
 template <class Body, class Allocator>
 boost::beast::http::message_generator handle_request(
     beast::string_view doc_root,
     boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>>&& req,
     std::shared_ptr<Application> app);
 
+// A plaintext static response that can be written with sendfile: the
+// serialized header, then length bytes of the file starting at offset.
+struct sendfile_response
+{
+    std::string header;
+    std::shared_ptr<range_body::file_handle const> file;
+    std::uint64_t offset;
+    std::uint64_t length;
+    bool keep_alive;
+};
+
+// For a plain GET of a static file too large for the FileCache, open it and
+// build its header. Anything else (HEAD, ranges, 304s, cached files,
+// errors) returns none and goes through handle_request as usual.
+template <class Body, class Allocator>
+boost::optional<sendfile_response> prepare_sendfile(
+    beast::string_view doc_root,
+    boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> const& req,
+    std::shared_ptr<Application> app);
+
 #endif // HTTP_TOOLS_HPP
 
@@ -5,25 +5,48 @@
 #include <boost/beast/http.hpp>
 #include <boost/beast/ssl.hpp>
 #include <boost/asio.hpp>
+#include "context_holder.hpp"
 #include <memory>
 #include <string>
 
+// Accepts connections and starts a TLS session for each, or a plaintext
+// one when constructed without a context_holder.
 class listener : public std::enable_shared_from_this<listener>
 {
     boost::asio::io_context& ioc_;
-    boost::asio::ssl::context& ctx_;
+    std::shared_ptr<context_holder> ctx_;
     boost::asio::ip::tcp::acceptor acceptor_;
     std::shared_ptr<std::string const> doc_root_;
     std::shared_ptr<Application> app_;
+    bool listening_ = false;
 public:
     listener(
         boost::asio::io_context& ioc,
-        boost::asio::ssl::context& ctx,
+        std::shared_ptr<context_holder> ctx,
         boost::asio::ip::tcp::endpoint endpoint,
         std::shared_ptr<std::string const> const& doc_root,
         std::shared_ptr<Application> app);
+
+    // Adopt a socket that is already listening, e.g. one inherited across exec
+    listener(
+        boost::asio::io_context& ioc,
+        std::shared_ptr<context_holder> ctx,
+        boost::asio::ip::tcp::endpoint endpoint,
+        boost::asio::ip::tcp::acceptor::native_handle_type handle,
+        std::shared_ptr<std::string const> const& doc_root,
+        std::shared_ptr<Application> app);
     void run();
 
+    // Whether the constructor left a socket ready to accept on; failures
+    // have been logged.
+    bool listening() const;
+
+    // The listening socket, for handing over to an upgraded process.
+    boost::asio::ip::tcp::acceptor::native_handle_type native_handle();
+
+    // Stop accepting new connections; existing sessions are left to finish.
+    void stop();
+
 private:
     void do_accept();
     void on_accept(boost::beast::error_code ec, boost::asio::ip::tcp::socket socket);
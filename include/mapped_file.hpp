@@ -0,0 +1,45 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+
+// A read-only mmap of a whole file. Mappings are shared: while any response
+// still holds one, opening the same version of the file again returns it,
+// so concurrent requests read the same page-cache pages with no read
+// syscalls or user-space copies. Use as the owner of a shared_body or
+// range_body slice.
+//
+// A file truncated while mapped makes reads past the new end fault. The
+// fault is caught and the lost tail reads as zeros, so the server survives
+// but that response is corrupt; files should be replaced by rename rather
+// than rewritten in place.
+class mapped_file
+{
+    char const* data_;
+    std::size_t size_;
+    std::uint64_t inode_;
+    std::int64_t mtime_;
+    std::size_t slot_;
+
+public:
+    // Map the file described by st, or reuse a live mapping of it. Returns
+    // nullptr if it cannot be mapped, e.g. because it is not a regular file.
+    // A descriptor already open on that file may be passed to skip the open.
+    static std::shared_ptr<mapped_file const> open(std::string const& path, struct stat const& st, int fd = -1);
+
+    mapped_file(char const* data, std::size_t size, std::uint64_t inode, std::int64_t mtime, std::size_t slot);
+    ~mapped_file();
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    char const* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+    // Whether the file shrank under the mapping and a read hit the gap
+    bool torn() const;
+};
+
+#endif // MAPPED_FILE_HPP
@@ -0,0 +1,115 @@
+#ifndef MIDDLEWARE_HPP
+#define MIDDLEWARE_HPP
+
+#include "beast.hpp"
+#include <boost/optional.hpp>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// A chain of middleware fixed at compile time, for logic that applies to
+// every request: auth, CORS, metrics. A middleware is any type with
+// either or both of
+//
+//     // Answer the request here, skipping the handlers and later stages
+//     template<class Request>
+//     boost::optional<http::response<http::string_body>> on_request(Request& req);
+//
+//     // Adjust the headers of a response on its way out
+//     template<class Request, class Fields>
+//     void on_response(Request const& req, http::header<false, Fields>& res);
+//
+// on_request runs in declaration order before routing; on_response runs
+// in reverse order on every response the handlers build, and on a
+// short-circuited response for the stages before the one that answered.
+// The stages are members of a tuple and hooks are found by overload
+// detection, so the pipeline is a sequence of direct calls the compiler
+// can inline, and a stage without a hook costs nothing.
+//
+// The server keeps one pipeline, and every I/O thread and the Queue call
+// into it at once. Hooks must therefore be safe to run concurrently: keep
+// stages stateless or read-only once requests are flowing, and put
+// anything they update in atomics, behind a lock, or in thread_local
+// storage. get() is for configuring a stage before the server starts.
+template<class... Middleware>
+class pipeline
+{
+public:
+    pipeline() = default;
+
+    explicit pipeline(Middleware... stages)
+        : stages_(std::move(stages)...)
+    {
+    }
+
+    template<class Request>
+    boost::optional<http::response<http::string_body>> on_request(Request& req)
+    {
+        return request_from<0>(req);
+    }
+
+    template<class Request, class Fields>
+    void on_response(Request const& req, http::header<false, Fields>& res)
+    {
+        response_through<sizeof...(Middleware)>(req, res);
+    }
+
+    template<std::size_t I>
+    auto& get() { return std::get<I>(stages_); }
+
+private:
+    template<class M, class Request, class = void>
+    struct has_on_request : std::false_type {};
+
+    template<class M, class Request>
+    struct has_on_request<M, Request,
+        std::void_t<decltype(std::declval<M&>().on_request(std::declval<Request&>()))>> : std::true_type {};
+
+    template<class M, class Request, class Fields, class = void>
+    struct has_on_response : std::false_type {};
+
+    template<class M, class Request, class Fields>
+    struct has_on_response<M, Request, Fields,
+        std::void_t<decltype(std::declval<M&>().on_response(
+            std::declval<Request const&>(), std::declval<http::header<false, Fields>&>()))>> : std::true_type {};
+
+    template<std::size_t I, class Request>
+    boost::optional<http::response<http::string_body>> request_from(Request& req)
+    {
+        if constexpr(I == sizeof...(Middleware))
+        {
+            return boost::none;
+        }
+        else
+        {
+            using stage_type = std::tuple_element_t<I, std::tuple<Middleware...>>;
+            if constexpr(has_on_request<stage_type, Request>::value)
+            {
+                if(auto res = std::get<I>(stages_).on_request(req))
+                {
+                    response_through<I>(req, res->base());
+                    return res;
+                }
+            }
+            return request_from<I + 1>(req);
+        }
+    }
+
+    // Decorate with the stages before I, last first
+    template<std::size_t I, class Request, class Fields>
+    void response_through(Request const& req, http::header<false, Fields>& res)
+    {
+        if constexpr(I > 0)
+        {
+            using stage_type = std::tuple_element_t<I - 1, std::tuple<Middleware...>>;
+            if constexpr(has_on_response<stage_type, Request, Fields>::value)
+                std::get<I - 1>(stages_).on_response(req, res);
+            response_through<I - 1>(req, res);
+        }
+    }
+
+    std::tuple<Middleware...> stages_;
+};
+
+#endif // MIDDLEWARE_HPP
@@ -0,0 +1,267 @@
+#ifndef MIME_TABLE_HPP
+#define MIME_TABLE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Built-in extension to MIME type table with a perfect hash computed at
+// compile time. A lookup is one hash over the extension, one table load
+// and one comparison, whatever the number of entries.
+namespace mime_table {
+
+struct entry
+{
+    std::string_view ext;  // lowercase, without the dot
+    std::string_view type;
+};
+
+inline constexpr entry entries[] = {
+    {"htm", "text/html"},
+    {"html", "text/html"},
+    {"php", "text/html"},
+    {"xhtml", "application/xhtml+xml"},
+    {"css", "text/css"},
+    {"txt", "text/plain"},
+    {"csv", "text/csv"},
+    {"md", "text/markdown"},
+    {"ics", "text/calendar"},
+    {"vtt", "text/vtt"},
+    {"js", "application/javascript"},
+    {"mjs", "application/javascript"},
+    {"json", "application/json"},
+    {"map", "application/json"},
+    {"jsonld", "application/ld+json"},
+    {"webmanifest", "application/manifest+json"},
+    {"xml", "application/xml"},
+    {"rss", "application/rss+xml"},
+    {"atom", "application/atom+xml"},
+    {"yaml", "application/yaml"},
+    {"yml", "application/yaml"},
+    {"toml", "application/toml"},
+    {"wasm", "application/wasm"},
+    {"pdf", "application/pdf"},
+    {"rtf", "application/rtf"},
+    {"epub", "application/epub+zip"},
+    {"zip", "application/zip"},
+    {"gz", "application/gzip"},
+    {"tar", "application/x-tar"},
+    {"bz2", "application/x-bzip2"},
+    {"7z", "application/x-7z-compressed"},
+    {"rar", "application/vnd.rar"},
+    {"jar", "application/java-archive"},
+    {"bin", "application/octet-stream"},
+    {"doc", "application/msword"},
+    {"docx", "application/vnd.openxmlformats-officedocument.wordprocessingml.document"},
+    {"xls", "application/vnd.ms-excel"},
+    {"xlsx", "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet"},
+    {"ppt", "application/vnd.ms-powerpoint"},
+    {"pptx", "application/vnd.openxmlformats-officedocument.presentationml.presentation"},
+    {"odt", "application/vnd.oasis.opendocument.text"},
+    {"ods", "application/vnd.oasis.opendocument.spreadsheet"},
+    {"swf", "application/x-shockwave-flash"},
+    {"png", "image/png"},
+    {"apng", "image/apng"},
+    {"jpe", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"jpg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"bmp", "image/bmp"},
+    {"ico", "image/vnd.microsoft.icon"},
+    {"tiff", "image/tiff"},
+    {"tif", "image/tiff"},
+    {"svg", "image/svg+xml"},
+    {"svgz", "image/svg+xml"},
+    {"webp", "image/webp"},
+    {"avif", "image/avif"},
+    {"heic", "image/heic"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"ttf", "font/ttf"},
+    {"otf", "font/otf"},
+    {"eot", "application/vnd.ms-fontobject"},
+    {"flv", "video/x-flv"},
+    {"mp4", "video/mp4"},
+    {"m4v", "video/mp4"},
+    {"webm", "video/webm"},
+    {"ogv", "video/ogg"},
+    {"mov", "video/quicktime"},
+    {"avi", "video/x-msvideo"},
+    {"mkv", "video/x-matroska"},
+    {"mpeg", "video/mpeg"},
+    {"mpg", "video/mpeg"},
+    {"ts", "video/mp2t"},
+    {"m3u8", "application/vnd.apple.mpegurl"},
+    {"mp3", "audio/mpeg"},
+    {"m4a", "audio/mp4"},
+    {"aac", "audio/aac"},
+    {"ogg", "audio/ogg"},
+    {"oga", "audio/ogg"},
+    {"opus", "audio/opus"},
+    {"wav", "audio/wav"},
+    {"flac", "audio/flac"},
+    {"weba", "audio/webm"},
+    {"mid", "audio/midi"},
+    {"midi", "audio/midi"},
+};
+
+inline constexpr std::size_t entry_count = sizeof(entries) / sizeof(entries[0]);
+
+// Slots in the hash table; a power of two well above entry_count so a
+// collision-free seed turns up after a handful of tries
+inline constexpr std::size_t table_size = 1024;
+
+constexpr char lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// FNV-1a over the lowercased extension
+constexpr std::uint32_t hash(std::string_view s, std::uint32_t seed)
+{
+    std::uint32_t h = 2166136261u ^ seed;
+    for(char c : s)
+    {
+        h ^= static_cast<unsigned char>(lower(c));
+        h *= 16777619u;
+    }
+    return h;
+}
+
+constexpr bool collision_free(std::uint32_t seed)
+{
+    bool used[table_size] = {};
+    for(auto const& e : entries)
+    {
+        auto const slot = hash(e.ext, seed) & (table_size - 1);
+        if(used[slot])
+            return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr std::uint32_t find_seed()
+{
+    for(std::uint32_t seed = 0; seed < 10000; ++seed)
+        if(collision_free(seed))
+            return seed;
+    return ~0u;
+}
+
+inline constexpr std::uint32_t seed = find_seed();
+static_assert(seed != ~0u, "no perfect hash seed found; grow table_size");
+
+constexpr std::array<std::int16_t, table_size> build_table()
+{
+    std::array<std::int16_t, table_size> table{};
+    for(auto& slot : table)
+        slot = -1;
+    for(std::size_t i = 0; i < entry_count; ++i)
+        table[hash(entries[i].ext, seed) & (table_size - 1)] = static_cast<std::int16_t>(i);
+    return table;
+}
+
+inline constexpr auto table = build_table();
+
+constexpr bool iequals(std::string_view a, std::string_view lowercase)
+{
+    if(a.size() != lowercase.size())
+        return false;
+    for(std::size_t i = 0; i < a.size(); ++i)
+        if(lower(a[i]) != lowercase[i])
+            return false;
+    return true;
+}
+
+// lookup() for an extension already hashed with seed
+constexpr std::string_view lookup(std::string_view ext, std::uint32_t h)
+{
+    auto const index = table[h & (table_size - 1)];
+    if(index < 0)
+        return {};
+    auto const& e = entries[index];
+    return iequals(ext, e.ext) ? e.type : std::string_view();
+}
+
+// The built-in type for an extension without the dot, matched without
+// regard to case. Returns an empty view when the extension is unknown.
+constexpr std::string_view lookup(std::string_view ext)
+{
+    return lookup(ext, hash(ext, seed));
+}
+
+static_assert(lookup("HTML") == "text/html", "mime table lookup");
+static_assert(lookup("woff2") == "font/woff2", "mime table lookup");
+static_assert(lookup("nope").empty(), "mime table lookup");
+
+// Mappings loaded at run time, laid over the built-in table. Filled before
+// the server starts and only read afterwards. Open addressing over the same
+// hash, so a lookup hashes the extension once for both tables and neither
+// copies nor lowercases it.
+class overlay
+{
+    struct slot
+    {
+        std::string ext; // lowercase; empty for a free slot
+        std::string type;
+    };
+
+    std::vector<slot> slots_;
+    std::size_t count_ = 0;
+
+    void place(slot&& s)
+    {
+        auto i = hash(s.ext, seed) & (slots_.size() - 1);
+        while(! slots_[i].ext.empty() && slots_[i].ext != s.ext)
+            i = (i + 1) & (slots_.size() - 1);
+        if(slots_[i].ext.empty())
+            ++count_;
+        slots_[i] = std::move(s);
+    }
+
+public:
+    // Map an extension, without the dot, to a type; a later mapping of the
+    // same extension replaces an earlier one
+    void add(std::string_view ext, std::string_view type)
+    {
+        // Keep at most half the slots in use, so probes stay short
+        if(2 * (count_ + 1) > slots_.size())
+        {
+            auto old = std::move(slots_);
+            slots_ = std::vector<slot>(old.empty() ? 64 : 2 * old.size());
+            count_ = 0;
+            for(auto& s : old)
+                if(! s.ext.empty())
+                    place(std::move(s));
+        }
+        slot s{std::string(ext), std::string(type)};
+        for(auto& c : s.ext)
+            c = lower(c);
+        place(std::move(s));
+    }
+
+    std::size_t size() const { return count_; }
+
+    // The type for an extension, from the overlay or else the built-in
+    // table. Returns an empty view when neither knows it.
+    std::string_view lookup(std::string_view ext) const
+    {
+        auto const h = hash(ext, seed);
+        if(! slots_.empty())
+        {
+            for(auto i = h & (slots_.size() - 1); ! slots_[i].ext.empty(); i = (i + 1) & (slots_.size() - 1))
+                if(iequals(ext, slots_[i].ext))
+                    return slots_[i].type;
+        }
+        return mime_table::lookup(ext, h);
+    }
+};
+
+} // namespace mime_table
+
+#endif // MIME_TABLE_HPP
@@ -0,0 +1,43 @@
+#ifndef PLAIN_SESSION_HPP
+#define PLAIN_SESSION_HPP
+
+#include "http_tools.hpp"
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/asio.hpp>
+#include <memory>
+#include <string>
+
+// An HTTP session without TLS, for running behind a proxy that terminates
+// it. Large static files skip user space entirely: the header is written
+// normally, then the file goes from the page cache to the socket with
+// sendfile, waiting on the reactor whenever the socket buffer is full.
+// Each such wait is bounded by the same 30 second timeout as the stream.
+class plain_session : public std::enable_shared_from_this<plain_session>
+{
+    boost::beast::tcp_stream stream_;
+    boost::asio::steady_timer send_timer_; // bounds waits for a writable socket
+    boost::beast::flat_buffer buffer_;
+    std::shared_ptr<std::string const> doc_root_;
+    boost::beast::http::request<boost::beast::http::string_body> req_;
+    std::shared_ptr<Application> app_;
+    sendfile_response file_;
+    public:
+    plain_session(
+            boost::asio::ip::tcp::socket&& socket,
+            std::shared_ptr<std::string const> const& doc_root,
+            std::shared_ptr<Application> app);
+
+    void run();
+
+    private:
+    void do_read();
+    void on_read(boost::beast::error_code ec, std::size_t bytes_transferred);
+    void send_response(boost::beast::http::message_generator&& msg);
+    void on_write(bool keep_alive, boost::beast::error_code ec, std::size_t bytes_transferred);
+    void on_header(boost::beast::error_code ec, std::size_t bytes_transferred);
+    void do_sendfile();
+    void do_close();
+};
+
+#endif // PLAIN_SESSION_HPP
@@ -0,0 +1,118 @@
+#ifndef RANGE_BODY_HPP
+#define RANGE_BODY_HPP
+
+#include "beast.hpp"
+#include <boost/optional.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+// A response body made of slices. In-memory slices are written as they
+// are; file slices are read with pread in fixed-size chunks, so only the
+// requested bytes ever leave the page cache and the file offset is never
+// shared state. A single range is one slice, multipart/byteranges
+// interleaves boundary buffers with slices.
+struct range_body
+{
+    // An open file descriptor, closed with the last slice that reads it
+    class file_handle
+    {
+        int fd_;
+    public:
+        explicit file_handle(int fd) : fd_(fd) {}
+        ~file_handle() { if(fd_ >= 0) ::close(fd_); }
+        file_handle(file_handle const&) = delete;
+        file_handle& operator=(file_handle const&) = delete;
+        int fd() const { return fd_; }
+    };
+
+    struct slice
+    {
+        std::shared_ptr<void const> owner;        // keeps data alive
+        char const* data = nullptr;                // in-memory bytes, or
+        std::shared_ptr<file_handle const> file;   // a region of a file
+        std::uint64_t offset = 0;                  // file offset
+        std::uint64_t size = 0;
+    };
+
+    struct value_type
+    {
+        std::vector<slice> slices;
+    };
+
+    static std::uint64_t size(value_type const& body)
+    {
+        std::uint64_t total = 0;
+        for(auto const& s : body.slices)
+            total += s.size;
+        return total;
+    }
+
+    class writer
+    {
+        static constexpr std::size_t chunk_size = 64 * 1024;
+
+        value_type const& body_;
+        std::size_t index_ = 0;
+        std::uint64_t done_ = 0;
+        std::unique_ptr<char[]> chunk_;
+
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        template<bool isRequest, class Fields>
+        writer(http::header<isRequest, Fields> const&, value_type const& body)
+            : body_(body)
+        {
+        }
+
+        void init(beast::error_code& ec)
+        {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec)
+        {
+            ec = {};
+            while(index_ < body_.slices.size() && body_.slices[index_].size == 0)
+                ++index_;
+            if(index_ == body_.slices.size())
+                return boost::none;
+
+            auto const& s = body_.slices[index_];
+            if(s.data)
+            {
+                ++index_;
+                return {{const_buffers_type(s.data, s.size), index_ < body_.slices.size()}};
+            }
+
+            if(! chunk_)
+                chunk_.reset(new char[chunk_size]);
+            auto const want = static_cast<std::size_t>(
+                std::min<std::uint64_t>(s.size - done_, chunk_size));
+            auto const n = ::pread(s.file->fd(), chunk_.get(), want,
+                static_cast<off_t>(s.offset + done_));
+            if(n <= 0)
+            {
+                // The file shrank underneath us or the read failed
+                ec = n < 0
+                    ? beast::error_code(errno, beast::system_category())
+                    : beast::error_code(http::error::short_read);
+                return boost::none;
+            }
+            done_ += static_cast<std::uint64_t>(n);
+            if(done_ == s.size)
+            {
+                ++index_;
+                done_ = 0;
+            }
+            return {{const_buffers_type(chunk_.get(), static_cast<std::size_t>(n)),
+                     index_ < body_.slices.size()}};
+        }
+    };
+};
+
+#endif // RANGE_BODY_HPP
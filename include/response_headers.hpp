@@ -0,0 +1,57 @@
+#ifndef RESPONSE_HEADERS_HPP
+#define RESPONSE_HEADERS_HPP
+
+#include "beast.hpp"
+#include <ctime>
+#include <string>
+
+// Header values shared by every response, kept ready so building one
+// formats nothing. The Date value is formatted once a second by tick(),
+// driven by the Application's timer, and each thread keeps its own copy
+// so reading it takes no lock. Serialized blocks holding the status line,
+// Server and Content-Type are kept per thread for the combinations the
+// server actually sends.
+namespace response_headers {
+
+// Format a time as an HTTP-date
+std::string http_date(std::time_t t);
+
+// Format the current second for date(); called once a second
+void tick();
+
+// The current HTTP-date; valid until the next call on this thread
+beast::string_view date();
+
+// "HTTP/1.1 200 OK\r\nServer: ...\r\nContent-Type: ...\r\n"; valid until
+// the next call on this thread
+beast::string_view block(unsigned version, http::status status, beast::string_view content_type);
+
+// Set Server and Date
+template<class Fields>
+void stamp(http::header<false, Fields>& res)
+{
+    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::date, date());
+}
+
+// Add token to Vary, keeping the tokens already there. Handlers and
+// header rules may both contribute, in either order.
+template<class Fields>
+void vary(http::header<false, Fields>& res, beast::string_view token)
+{
+    auto const current = res[http::field::vary];
+    if(current.empty())
+        return res.set(http::field::vary, token);
+    for(auto const& t : http::token_list{current})
+        if(t == "*" || beast::iequals(t, token))
+            return;
+    if(token == "*")
+        return res.set(http::field::vary, token);
+    std::string merged(current);
+    merged.append(", ").append(token.data(), token.size());
+    res.set(http::field::vary, merged);
+}
+
+} // namespace response_headers
+
+#endif // RESPONSE_HEADERS_HPP
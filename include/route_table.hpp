@@ -0,0 +1,243 @@
+#ifndef ROUTE_TABLE_HPP
+#define ROUTE_TABLE_HPP
+
+#include "beast.hpp"
+#include "router.hpp"
+#include <boost/optional.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Routes declared as a constexpr table of (method, pattern, handler), with
+// path parameters passed to the handler as typed arguments:
+//
+//     http::message_generator show_user(context& ctx, int id);
+//     http::message_generator show_file(context& ctx, beast::string_view path);
+//
+//     constexpr auto routes = std::make_tuple(
+//         route(http::verb::get, "/users/:id", &show_user),
+//         route(http::verb::get, "/files/*path", &show_file));
+//
+//     static auto const r = make_router<routes>();
+//
+// The table is checked while compiling: a malformed pattern, a pattern
+// whose parameter count differs from its handler's, a route declared
+// twice, or two routes naming the same parameter differently is an error
+// in the constant expression. Parameters are parsed by route_param<T>, in
+// pattern order; a value that does not parse skips the handler, and the
+// caller answers as for an unknown path.
+
+// Parses a path parameter into T; specialise for more types
+template<class T>
+struct route_param;
+
+template<>
+struct route_param<beast::string_view>
+{
+    static bool parse(beast::string_view s, beast::string_view& out)
+    {
+        out = s;
+        return true;
+    }
+};
+
+template<>
+struct route_param<int>
+{
+    static bool parse(beast::string_view s, int& out)
+    {
+        auto const end = s.data() + s.size();
+        auto const r = std::from_chars(s.data(), end, out);
+        return ! s.empty() && r.ec == std::errc() && r.ptr == end;
+    }
+};
+
+// A UUID in its canonical 8-4-4-4-12 hex form
+template<>
+struct route_param<boost::uuids::uuid>
+{
+    static bool parse(beast::string_view s, boost::uuids::uuid& out)
+    {
+        if(s.size() != 36)
+            return false;
+        auto const hex = [](char c) -> int
+        {
+            if(c >= '0' && c <= '9') return c - '0';
+            if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        };
+        std::size_t byte = 0;
+        for(std::size_t i = 0; i < s.size();)
+        {
+            if(i == 8 || i == 13 || i == 18 || i == 23)
+            {
+                if(s[i++] != '-')
+                    return false;
+                continue;
+            }
+            int const hi = hex(s[i]);
+            int const lo = hex(s[i + 1]);
+            if(hi < 0 || lo < 0)
+                return false;
+            out.data[byte++] = static_cast<std::uint8_t>(hi << 4 | lo);
+            i += 2;
+        }
+        return true;
+    }
+};
+
+// The number of parameters in a pattern; throws on a malformed one, which
+// in a constant expression fails the build.
+constexpr std::size_t route_pattern_arity(std::string_view pattern)
+{
+    if(pattern.empty() || pattern.front() != '/')
+        throw std::invalid_argument("route must start with '/'");
+    std::size_t count = 0;
+    for(std::size_t i = 0; i < pattern.size(); ++i)
+    {
+        char const c = pattern[i];
+        if(c != ':' && c != '*')
+            continue;
+        if(pattern[i - 1] != '/')
+            throw std::invalid_argument("route parameter must start a segment");
+        std::size_t end = i + 1;
+        while(end < pattern.size() && pattern[end] != '/')
+        {
+            char const n = pattern[end++];
+            if(! ((n >= 'a' && n <= 'z') || (n >= 'A' && n <= 'Z') || (n >= '0' && n <= '9') || n == '_'))
+                throw std::invalid_argument("route parameter name must be alphanumeric");
+        }
+        if(end == i + 1)
+            throw std::invalid_argument("route parameter must be named");
+        if(c == '*' && end != pattern.size())
+            throw std::invalid_argument("route wildcard must end the pattern");
+        ++count;
+        i = end - 1;
+    }
+    if(count > route_params::capacity)
+        throw std::invalid_argument("too many route parameters");
+    return count;
+}
+
+template<class Context, class... Args>
+struct typed_route
+{
+    using context_type = Context;
+    using handler_type = http::message_generator (*)(Context&, Args...);
+    static constexpr std::size_t arity = sizeof...(Args);
+
+    http::verb method;
+    std::string_view pattern;
+    handler_type handler;
+};
+
+// Declare a route
+template<class Context, class... Args>
+constexpr typed_route<Context, Args...> route(
+    http::verb method,
+    std::string_view pattern,
+    http::message_generator (*handler)(Context&, Args...))
+{
+    if(route_pattern_arity(pattern) != sizeof...(Args))
+        throw std::invalid_argument("route parameters do not match the handler's");
+    return {method, pattern, handler};
+}
+
+// What make_router registers for each route: parses the parameters and
+// calls the handler, or returns none if one does not parse
+template<class Context>
+using route_thunk = boost::optional<http::message_generator> (*)(Context&, route_params const&);
+
+namespace detail {
+
+// Whether two patterns name a parameter in the same position differently
+constexpr bool conflicting_params(std::string_view a, std::string_view b)
+{
+    std::size_t i = 0;
+    while(i < a.size() && i < b.size() && a[i] == b[i])
+    {
+        if(a[i] == ':' || a[i] == '*')
+        {
+            auto const end_a = a.find('/', i) == std::string_view::npos ? a.size() : a.find('/', i);
+            auto const end_b = b.find('/', i) == std::string_view::npos ? b.size() : b.find('/', i);
+            if(a.substr(i, end_a - i) != b.substr(i, end_b - i))
+                return true;
+            i = end_a;
+            continue;
+        }
+        ++i;
+    }
+    return false;
+}
+
+template<auto const& Table, std::size_t... I>
+constexpr bool check_routes(std::index_sequence<I...>)
+{
+    constexpr std::size_t n = sizeof...(I);
+    std::array<http::verb, n> const methods{{std::get<I>(Table).method...}};
+    std::array<std::string_view, n> const patterns{{std::get<I>(Table).pattern...}};
+    for(std::size_t i = 0; i < n; ++i)
+    {
+        for(std::size_t j = i + 1; j < n; ++j)
+        {
+            if(methods[i] == methods[j] && patterns[i] == patterns[j])
+                throw std::invalid_argument("route declared twice");
+            if(conflicting_params(patterns[i], patterns[j]))
+                throw std::invalid_argument("routes name a parameter differently");
+        }
+    }
+    return true;
+}
+
+template<class Context, class... Args, std::size_t... N>
+boost::optional<http::message_generator> invoke_route(
+    http::message_generator (*handler)(Context&, Args...),
+    Context& ctx,
+    route_params const& params,
+    std::index_sequence<N...>)
+{
+    std::tuple<std::decay_t<Args>...> args;
+    if(! (route_param<std::decay_t<Args>>::parse(params[N], std::get<N>(args)) && ...))
+        return boost::none;
+    return handler(ctx, std::get<N>(std::move(args))...);
+}
+
+template<auto const& Table, std::size_t I, class Context>
+boost::optional<http::message_generator> thunk(Context& ctx, route_params const& params)
+{
+    constexpr auto const& r = std::get<I>(Table);
+    return invoke_route(r.handler, ctx, params, std::make_index_sequence<std::decay_t<decltype(r)>::arity>());
+}
+
+template<auto const& Table, class Context, std::size_t... I>
+void add_routes(router<route_thunk<Context>>& r, std::index_sequence<I...>)
+{
+    (r.add(std::get<I>(Table).method,
+        beast::string_view(std::get<I>(Table).pattern.data(), std::get<I>(Table).pattern.size()),
+        &thunk<Table, I, Context>), ...);
+}
+
+} // namespace detail
+
+// Build a router over a constexpr route table
+template<auto const& Table>
+auto make_router()
+{
+    using table_type = std::decay_t<decltype(Table)>;
+    using context = typename std::tuple_element_t<0, table_type>::context_type;
+    constexpr auto indices = std::make_index_sequence<std::tuple_size<table_type>::value>();
+    static_assert(detail::check_routes<Table>(indices), "invalid route table");
+
+    router<route_thunk<context>> r;
+    detail::add_routes<Table, context>(r, indices);
+    return r;
+}
+
+#endif // ROUTE_TABLE_HPP
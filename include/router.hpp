@@ -0,0 +1,249 @@
+#ifndef ROUTER_HPP
+#define ROUTER_HPP
+
+#include "beast.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Parameters captured while matching a route, as views into the matched
+// path; valid as long as the request target is.
+class route_params
+{
+public:
+    static constexpr std::size_t capacity = 8;
+
+    // The value of a named parameter, or an empty view
+    beast::string_view get(beast::string_view name) const
+    {
+        for(std::size_t i = 0; i < size_; ++i)
+            if(items_[i].first == name)
+                return items_[i].second;
+        return {};
+    }
+
+    beast::string_view operator[](std::size_t i) const { return items_[i].second; }
+    std::size_t size() const { return size_; }
+
+    void push(beast::string_view name, beast::string_view value) { items_[size_++] = {name, value}; }
+    void pop() { --size_; }
+    void clear() { size_ = 0; }
+
+private:
+    std::array<std::pair<beast::string_view, beast::string_view>, capacity> items_;
+    std::size_t size_ = 0;
+};
+
+// Routes request paths to handlers with a compressed radix tree. Patterns
+// are made of static text, ":name" segments matching up to the next '/',
+// and a trailing "*name" matching the rest of the path:
+//
+//     /users/:id/posts
+//     /static/*path
+//
+// Each node holds a handler per method. Matching walks the path once,
+// trying static text before a parameter before a wildcard and backing up
+// when a branch dead-ends or lacks the method; it allocates nothing and
+// returns the captured parameters as views into the path. Routes are added at startup, and a
+// built router is safe to match from any number of threads.
+template<class Handler>
+class router
+{
+public:
+    class route
+    {
+        friend class router;
+        std::vector<std::pair<http::verb, Handler>> handlers_;
+    public:
+        // The handler for a method, or nullptr
+        Handler const* find(http::verb method) const
+        {
+            for(auto const& h : handlers_)
+                if(h.first == method)
+                    return &h.second;
+            return nullptr;
+        }
+    };
+
+    // Add a handler; throws std::invalid_argument on a malformed or
+    // conflicting pattern.
+    void add(http::verb method, beast::string_view pattern, Handler handler)
+    {
+        if(pattern.empty() || pattern.front() != '/')
+            throw std::invalid_argument("Route must start with '/': " + std::string(pattern));
+        std::size_t params = 0;
+        for(char c : pattern)
+            params += c == ':' || c == '*';
+        if(params > route_params::capacity)
+            throw std::invalid_argument("Too many parameters in route: " + std::string(pattern));
+
+        auto& r = insert(root_, pattern, pattern);
+        if(r.find(method))
+            throw std::invalid_argument("Duplicate route: " + std::string(http::to_string(method)) + " " + std::string(pattern));
+        r.handlers_.emplace_back(method, std::move(handler));
+    }
+
+    struct match_result
+    {
+        Handler const* handler = nullptr; // for the method and path
+        std::vector<http::verb> allowed;  // methods of every route for the path
+
+        // Comma-separated methods, for the Allow header of a 405
+        std::string allow() const
+        {
+            std::string methods;
+            for(auto const m : allowed)
+            {
+                if(! methods.empty())
+                    methods.append(", ");
+                methods.append(std::string(http::to_string(m)));
+            }
+            return methods;
+        }
+    };
+
+    // Find the handler for a method and path, filling in its parameters.
+    // Without one, allowed holds the methods the path exists under, across
+    // all the routes that match it.
+    match_result match(http::verb method, beast::string_view path, route_params& params) const
+    {
+        match_result result;
+        params.clear();
+        match(root_, method, path, params, result);
+        return result;
+    }
+
+private:
+    struct node
+    {
+        std::string prefix;   // static text on the edge into this node
+        std::string indices;  // first character of each static child
+        std::vector<std::unique_ptr<node>> children;
+        std::unique_ptr<node> param;
+        std::string param_name;
+        std::unique_ptr<node> wildcard;
+        std::string wildcard_name;
+        route value;
+        bool terminal = false;
+    };
+
+    static route& insert(node& n, beast::string_view rest, beast::string_view pattern)
+    {
+        if(rest.empty())
+        {
+            n.terminal = true;
+            return n.value;
+        }
+
+        if(rest.front() == ':' || rest.front() == '*')
+        {
+            bool const wild = rest.front() == '*';
+            auto const end = wild ? rest.size() : std::min(rest.find('/'), rest.size());
+            std::string const name(rest.substr(1, end - 1));
+            if(name.empty())
+                throw std::invalid_argument("Unnamed parameter in route: " + std::string(pattern));
+            auto& child = wild ? n.wildcard : n.param;
+            auto& child_name = wild ? n.wildcard_name : n.param_name;
+            if(! child)
+            {
+                child = std::make_unique<node>();
+                child_name = name;
+            }
+            else if(child_name != name)
+            {
+                throw std::invalid_argument("Conflicting parameter names in route: " + std::string(pattern));
+            }
+            return insert(*child, rest.substr(end), pattern);
+        }
+
+        // Static text up to the next parameter
+        auto const text = rest.substr(0, std::min(rest.find_first_of(":*"), rest.size()));
+        auto const i = n.indices.find(text.front());
+        if(i == std::string::npos)
+        {
+            auto child = std::make_unique<node>();
+            child->prefix = std::string(text);
+            n.indices.push_back(text.front());
+            n.children.push_back(std::move(child));
+            return insert(*n.children.back(), rest.substr(text.size()), pattern);
+        }
+
+        // Split the existing edge where it stops agreeing with the pattern
+        auto& child = n.children[i];
+        std::size_t common = 0;
+        while(common < text.size() && common < child->prefix.size() && text[common] == child->prefix[common])
+            ++common;
+        if(common < child->prefix.size())
+        {
+            auto split = std::make_unique<node>();
+            split->prefix = child->prefix.substr(0, common);
+            child->prefix.erase(0, common);
+            split->indices.push_back(child->prefix.front());
+            split->children.push_back(std::move(child));
+            child = std::move(split);
+        }
+        return insert(*child, rest.substr(common), pattern);
+    }
+
+    static bool match(node const& n, http::verb method, beast::string_view path, route_params& params, match_result& result)
+    {
+        if(path.empty() && n.terminal)
+        {
+            result.handler = n.value.find(method);
+            if(result.handler)
+                return true;
+            allow(n.value, result);
+        }
+
+        if(! path.empty())
+        {
+            auto const i = n.indices.find(path.front());
+            if(i != std::string::npos)
+            {
+                auto const& child = *n.children[i];
+                if(path.substr(0, child.prefix.size()) == child.prefix &&
+                    match(child, method, path.substr(child.prefix.size()), params, result))
+                    return true;
+            }
+        }
+
+        if(n.param)
+        {
+            auto const end = std::min(path.find('/'), path.size());
+            if(end > 0)
+            {
+                params.push(n.param_name, path.substr(0, end));
+                if(match(*n.param, method, path.substr(end), params, result))
+                    return true;
+                params.pop();
+            }
+        }
+
+        if(n.wildcard && n.wildcard->terminal)
+        {
+            params.push(n.wildcard_name, path);
+            result.handler = n.wildcard->value.find(method);
+            if(result.handler)
+                return true;
+            params.pop();
+            allow(n.wildcard->value, result);
+        }
+        return false;
+    }
+
+    static void allow(route const& r, match_result& result)
+    {
+        for(auto const& h : r.handlers_)
+            if(std::find(result.allowed.begin(), result.allowed.end(), h.first) == result.allowed.end())
+                result.allowed.push_back(h.first);
+    }
+
+    node root_;
+};
+
+#endif // ROUTER_HPP
@@ -4,10 +4,11 @@
 #include <boost/asio/buffer.hpp>
 #include <boost/asio/ssl/context.hpp>
 #include <fstream>
+#include <mutex>
 #include <sstream>
 #include "dotenv.hpp"
 
-std::string load_file_content(const std::string& file_path) {
+inline std::string load_file_content(const std::string& file_path) {
     std::ifstream file(file_path);
     if (!file.is_open()) {
         throw std::runtime_error("Could not open file: " + file_path);
@@ -17,10 +18,18 @@ std::string load_file_content(const std::string& file_path) {
     return buffer.str();
 }
 
+// Load environment variables from the .env file. Only done once, so that
+// reloading certificates never rewrites the environment while other
+// threads may be reading it.
+inline void load_environment()
+{
+    static std::once_flag env_loaded;
+    std::call_once(env_loaded, [] { dotenv::init(".env"); });
+}
+
 inline void load_server_certificate(boost::asio::ssl::context& ctx)
 {
-    // Load environment variables from the .env file
-    dotenv::init(".env");
+    load_environment();
 
     // Retrieve file paths and password from the environment
     const char* cert_path = std::getenv("CERT_PATH");
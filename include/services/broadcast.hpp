@@ -0,0 +1,67 @@
+#ifndef BROADCAST_HPP
+#define BROADCAST_HPP
+
+#include "../beast.hpp"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The Broadcast class fans Server-Sent Events out to every subscriber of a
+// channel. Each event is encoded once into a shared immutable buffer which
+// all subscribers write from, so publishing to N connections costs N
+// reference count increments rather than N copies.
+class Broadcast {
+public:
+    using Buffer = std::shared_ptr<std::string const>;
+
+    // Interface implemented by connections that stream events to a client.
+    class Subscriber {
+    public:
+        virtual ~Subscriber() = default;
+
+        // Queue an encoded event for writing. Returns false when the
+        // subscriber has fallen too far behind and should be dropped.
+        virtual bool deliver(Buffer const& event) = 0;
+
+        // Close the connection. Safe to call from any thread.
+        virtual void close() = 0;
+    };
+
+    // Constructor: max_pending is the number of undelivered events a
+    // subscriber may hold before it is considered too slow and dropped.
+    explicit Broadcast(std::size_t max_pending = 64);
+
+    // Register a target path that clients can subscribe to.
+    void add_channel(const std::string& path);
+
+    // Returns true if the target (query string ignored) names a channel.
+    bool has_channel(beast::string_view target) const;
+
+    // Attach a subscriber to a channel.
+    void subscribe(beast::string_view target, std::weak_ptr<Subscriber> subscriber);
+
+    // Encode an event once and hand it to every subscriber of the channel.
+    // Returns the number of subscribers that received it.
+    std::size_t publish(const std::string& path, const std::string& event, const std::string& data);
+
+    // Close every subscriber, used when the server is shutting down.
+    void close_all();
+
+    std::size_t max_pending() const;
+
+    // Encode an event in text/event-stream format. Line breaks are dropped
+    // from the event name and split the data into lines.
+    static Buffer encode(const std::string& event, const std::string& data);
+
+private:
+    static beast::string_view channel_of(beast::string_view target);
+
+    std::size_t max_pending_;
+    std::unordered_map<std::string, std::vector<std::weak_ptr<Subscriber>>> channels_;
+    mutable std::mutex channels_mutex_;
+};
+
+#endif // BROADCAST_HPP
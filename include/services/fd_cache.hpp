@@ -0,0 +1,84 @@
+#ifndef FD_CACHE_HPP
+#define FD_CACHE_HPP
+
+#include "watcher.hpp"
+#include "../range_body.hpp"
+#include "../singleflight.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <sys/stat.h>
+
+// An open regular file and the stat taken when it was opened.
+struct OpenFile {
+    std::string path;
+    struct stat st;
+    std::shared_ptr<range_body::file_handle const> file;
+};
+
+// The FdCache class keeps descriptors of recently served files open, with
+// their metadata, so repeated requests for a large file need neither stat
+// nor open. The descriptor is only read with pread and sendfile at explicit
+// offsets, so one descriptor is shared by every concurrent response.
+//
+// Entries are dropped when the Watcher reports a change to the path, and
+// are revalidated with stat once older than ttl in case an event was
+// missed. The number of entries is bounded so descriptors stay well within
+// the process limit. Concurrent misses for one path share a single open.
+class FdCache {
+public:
+    struct Stats {
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t coalesced; // misses that waited on another's open
+        std::size_t entries;
+    };
+
+    // Constructor: directories of opened files are added to the watcher,
+    // whose events should be passed to invalidate().
+    FdCache(std::size_t max_entries,
+            std::chrono::milliseconds ttl,
+            std::shared_ptr<Watcher> watcher);
+
+    // Returns the open file, opening it on a miss. Returns nullptr when the
+    // path does not exist or is not a regular file.
+    std::shared_ptr<OpenFile const> get(const std::string& path);
+
+    // Drop a path; an empty path drops everything.
+    void invalidate(const std::string& path);
+
+    // Change how long entries are trusted without a stat.
+    void set_ttl(std::chrono::milliseconds ttl);
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        std::shared_ptr<OpenFile const> file;
+        std::chrono::steady_clock::time_point checked;
+        std::list<std::string>::iterator lru;
+    };
+
+    std::shared_ptr<OpenFile const> open(const std::string& path) const;
+    void insert(std::shared_ptr<OpenFile const> file, std::chrono::steady_clock::time_point now);
+
+    std::size_t max_entries_;
+    std::atomic<std::chrono::milliseconds> ttl_;
+    std::shared_ptr<Watcher> watcher_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_; // most recently used first
+    singleflight<std::string, std::shared_ptr<OpenFile const>> opens_;
+
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> misses_{0};
+    std::atomic<std::uint64_t> coalesced_{0};
+};
+
+#endif // FD_CACHE_HPP
@@ -0,0 +1,141 @@
+#ifndef FILE_CACHE_HPP
+#define FILE_CACHE_HPP
+
+#include "../singleflight.hpp"
+#include <boost/asio/thread_pool.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// An immutable snapshot of a file's contents and metadata.
+struct CachedFile {
+    std::string path;
+    std::uint64_t size;
+    std::int64_t mtime; // nanoseconds since the epoch
+    std::uint64_t inode;
+    std::shared_ptr<std::string const> body;
+};
+
+// The FileCache class keeps the contents of small static files in memory.
+// Entries are keyed by resolved path and split across shards, each with its
+// own lock and LRU list, so concurrent lookups rarely contend. A hit is
+// served from the shared buffer without any syscall; once an entry is older
+// than the revalidation interval the next lookup stats the file and reloads
+// it if the mtime or size changed. Concurrent misses for the same path
+// share one read. Compression runs on the cache's own worker threads,
+// never on the thread serving the request.
+class FileCache {
+public:
+    // Bits describing the precompressed siblings of a file
+    static constexpr unsigned gzip = 1;   // path.gz
+    static constexpr unsigned brotli = 2; // path.br
+
+    struct Stats {
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t coalesced; // misses that waited on another's load
+        std::uint64_t evictions;
+        std::size_t entries;
+        std::size_t bytes;
+    };
+
+    // Constructor: max_bytes bounds the total size of cached contents,
+    // files larger than max_file_size are never cached.
+    FileCache(std::size_t max_bytes,
+              std::size_t max_file_size,
+              std::chrono::milliseconds revalidate,
+              std::size_t shards = 16);
+
+    // Returns the file, loading it on a miss. Returns nullptr when the file
+    // does not exist, cannot be read, or is too large to cache. A file
+    // found too large is remembered, so until the revalidation interval
+    // passes or it changes, asking again costs no syscall.
+    std::shared_ptr<CachedFile const> get(const std::string& path);
+
+    // Which precompressed siblings of path exist, remembered per path and
+    // revalidated on the same interval as contents. Returns 0 when path
+    // itself does not exist.
+    unsigned precompressed(const std::string& path);
+
+    // The gzip-compressed form of a cached file, or nullptr until it is
+    // ready. The first request for a version queues its compression on a
+    // worker thread and should be answered uncompressed. The result is
+    // kept until the source entry changes or is evicted, so each version
+    // of a file is compressed only once.
+    std::shared_ptr<CachedFile const> gzipped(std::shared_ptr<CachedFile const> const& source);
+
+    // Drop a path from the cache; an empty path drops everything.
+    void invalidate(const std::string& path);
+
+    // Change how long entries are trusted without a stat, e.g. once a
+    // Watcher reports changes to every cached path.
+    void set_revalidate(std::chrono::milliseconds revalidate);
+
+    Stats stats() const;
+
+    // Files larger than this are never cached.
+    std::size_t max_file_size() const;
+
+private:
+    struct Entry {
+        std::shared_ptr<CachedFile const> file;
+        std::chrono::steady_clock::time_point checked;
+        std::list<std::string>::iterator lru;
+    };
+
+    struct Variants {
+        unsigned found;
+        std::chrono::steady_clock::time_point checked;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;
+        std::unordered_map<std::string, Variants> variants;
+        std::unordered_map<std::string, std::shared_ptr<CachedFile const>> compressed;
+        std::unordered_set<std::string> compressing; // queued on workers_
+        std::unordered_map<std::string, std::chrono::steady_clock::time_point> oversized; // when last checked
+        std::list<std::string> lru; // most recently used first
+        std::size_t bytes = 0;
+        std::uint64_t generation = 0; // bumped by invalidate()
+    };
+
+    Shard& shard_for(const std::string& path);
+    static std::uint64_t current_generation(Shard& shard);
+    // Read a file; too_large is set when it was rejected for its size
+    std::shared_ptr<CachedFile const> load(const std::string& path, bool& too_large) const;
+    // Store a file read when the shard was at generation; dropped if an
+    // invalidation ran since, as the read may predate the change
+    void insert(Shard& shard, std::shared_ptr<CachedFile const> file, std::uint64_t generation);
+    // A load at generation found nothing to cache: drop any stale entry,
+    // and remember the path if the file was too large
+    void reject(Shard& shard, const std::string& path, bool too_large, std::uint64_t generation);
+    void erase(Shard& shard, std::unordered_map<std::string, Entry>::iterator it);
+    // Evict least recently used entries, never keep, until size more bytes
+    // fit; returns false if they cannot
+    bool make_room(Shard& shard, std::size_t size, const std::string* keep);
+    void compress(std::shared_ptr<CachedFile const> source);
+
+    std::size_t shard_bytes_;
+    std::size_t max_file_size_;
+    std::atomic<std::chrono::milliseconds> revalidate_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    singleflight<std::string, std::shared_ptr<CachedFile const>> loads_;
+
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> misses_{0};
+    std::atomic<std::uint64_t> coalesced_{0};
+    std::atomic<std::uint64_t> evictions_{0};
+
+    // Last, so its threads are joined before the shards go away
+    boost::asio::thread_pool workers_;
+};
+
+#endif // FILE_CACHE_HPP
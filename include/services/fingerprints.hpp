@@ -0,0 +1,81 @@
+#ifndef FINGERPRINTS_HPP
+#define FINGERPRINTS_HPP
+
+#include "file_cache.hpp"
+#include <boost/optional.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// The Fingerprints class gives every file under the document root a URL
+// containing a hash of its contents, e.g. /app.3f2a9c01de.js for /app.js.
+// Such a URL always names the same bytes, so responses to it can be cached
+// forever; a changed file gets a new URL instead. Pages link the new URLs
+// by having their references rewritten as they are served.
+//
+// The manifest is built once at startup and kept current by update(),
+// which the Application feeds with Watcher events.
+class Fingerprints {
+public:
+    // A page with its references rewritten; file is null when nothing in
+    // the page needed rewriting. tag identifies the rewritten content and
+    // belongs in its ETag.
+    struct Page {
+        std::shared_ptr<CachedFile const> file;
+        std::string tag;
+    };
+
+    // Hash every file under doc_root. Returns the number of files.
+    std::size_t build(const std::string& doc_root);
+
+    // Returns true once a manifest has been built.
+    bool active() const;
+
+    // The URL path a fingerprinted one stands for, if it is current.
+    boost::optional<std::string> resolve(std::string_view url) const;
+
+    // The fingerprinted form of a URL path, or the path itself.
+    std::string url_for(std::string_view url) const;
+
+    // Replace src and href references to known files with their
+    // fingerprinted URLs. Relative references are resolved against
+    // page_url, the URL path of the page.
+    std::string rewrite_html(std::string_view html, std::string_view page_url) const;
+
+    // rewrite_html() for a cached page, remembered until the page or the
+    // manifest changes. page_url is the canonical URL path the page was
+    // requested by; any query is ignored. With gzip the rewritten page is
+    // also compressed.
+    Page rewrite(std::shared_ptr<CachedFile const> const& source, std::string_view page_url, bool gzip);
+
+    // A file under doc_root changed; complete as reported by the Watcher.
+    // Its fingerprinted URL is withdrawn until the file is complete again.
+    // An empty path rebuilds the whole manifest.
+    void update(const std::string& path, bool complete);
+
+private:
+    struct Rewritten {
+        std::shared_ptr<CachedFile const> source;
+        std::uint64_t version;
+        Page plain;
+        Page gzipped;
+    };
+
+    void add(const std::string& path);
+    void remove(const std::string& url);
+    std::string url_of(const std::string& path) const;
+
+    std::string root_;
+    std::atomic<bool> active_{false};
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::string> fingerprinted_; // URL path -> fingerprinted
+    std::unordered_map<std::string, std::string> logical_;       // fingerprinted -> URL path
+    std::unordered_map<std::string, Rewritten> pages_;           // by file path and URL directory
+    std::uint64_t version_ = 0;
+};
+
+#endif // FINGERPRINTS_HPP
@@ -0,0 +1,70 @@
+#ifndef NEGATIVE_CACHE_HPP
+#define NEGATIVE_CACHE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// The NegativeCache class remembers paths that were not found, so repeated
+// requests for them, typically from scanners probing for well-known files,
+// are answered without touching the disk.
+//
+// Each entry records the nearest directory on the path that exists and its
+// mtime. Creating the file, or any missing directory above it, changes that
+// directory's mtime, so an entry older than the revalidation interval is
+// trusted only while the mtime is unchanged. A Watcher can also drop
+// entries as soon as the file appears. Entries are bounded in LRU order.
+class NegativeCache {
+public:
+    struct Stats {
+        std::uint64_t hits;
+        std::size_t entries;
+    };
+
+    // Constructor: max_entries bounds the number of remembered paths.
+    NegativeCache(std::size_t max_entries, std::chrono::milliseconds revalidate);
+
+    // Returns true if path is known not to exist.
+    bool contains(const std::string& path);
+
+    // Taken before looking for a file, and passed to insert() if it is
+    // missing; changes whenever an entry may have been invalidated.
+    std::uint64_t generation() const;
+
+    // Remember that path does not exist, unless an invalidation ran since
+    // generation was taken, as the file may have been created after the
+    // lookup failed.
+    void insert(const std::string& path, std::uint64_t generation);
+
+    // Forget a path; an empty path forgets everything.
+    void invalidate(const std::string& path);
+
+    // Change how long entries are trusted without a stat.
+    void set_revalidate(std::chrono::milliseconds revalidate);
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        std::size_t ancestor; // length of the prefix naming the directory
+        std::int64_t mtime;   // of that directory, in nanoseconds
+        std::chrono::steady_clock::time_point checked;
+        std::list<std::string>::iterator lru;
+    };
+
+    std::size_t max_entries_;
+    std::atomic<std::chrono::milliseconds> revalidate_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_; // most recently used first
+    std::atomic<std::uint64_t> generation_{0}; // bumped by invalidate()
+
+    std::atomic<std::uint64_t> hits_{0};
+};
+
+#endif // NEGATIVE_CACHE_HPP
@@ -3,6 +3,7 @@
 
 #include "../beast.hpp"
 #include <boost/asio/steady_timer.hpp>
+#include <atomic>
 #include <functional>
 #include <chrono>
 #include <mutex>
@@ -24,9 +25,16 @@ public:
     // Add a request to the queue.
     void enqueue(RequestHandler handler);
 
+    // Add a request from inside a running one, which holds the queue; it
+    // is enqueued from the io_context once the current request returns.
+    void defer(RequestHandler handler);
+
     // Start processing the queue.
     void start();
 
+    // Returns true when no request is waiting or being processed.
+    bool idle() const;
+
 private: 
     // Internal method to process the next request
     void process_next();
@@ -46,6 +54,9 @@ private:
     // Mutex to protect access to the queue
     std::mutex queue_mutex_;
 
+    // Number of requests enqueued but not yet finished.
+    std::atomic<std::size_t> pending_{0};
+
     // Timer for handling delays between requests.
     boost::asio::steady_timer timer_;
 };
@@ -0,0 +1,92 @@
+#ifndef RESPONSE_CACHE_HPP
+#define RESPONSE_CACHE_HPP
+
+#include "../beast.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// A response kept by the ResponseCache. Date and Connection are left out
+// and set again for each request the response is replayed to.
+struct CachedResponse {
+    http::status status;
+    http::fields fields;
+    std::shared_ptr<std::string const> body;
+};
+
+// The ResponseCache class keeps whole responses of routes that opt in, so
+// an expensive read-mostly endpoint is answered from memory. Each entry is
+// fresh for its ttl, then served stale for up to its stale window while
+// the first request to notice rebuilds it in the background. Past that it
+// is a miss. Entries are bounded by total size in LRU order, and can be
+// purged by key prefix; keys start with the route they belong to.
+class ResponseCache {
+public:
+    struct Lookup {
+        std::shared_ptr<CachedResponse const> response; // nullptr on a miss
+        bool stale;   // past its ttl
+        bool refresh; // the caller should rebuild it; set for one caller only
+    };
+
+    struct Stats {
+        std::uint64_t hits;
+        std::uint64_t stale_hits;
+        std::uint64_t misses;
+        std::uint64_t evictions;
+        std::size_t entries;
+        std::size_t bytes;
+    };
+
+    // Constructor: max_bytes bounds the total size of cached responses.
+    explicit ResponseCache(std::size_t max_bytes);
+
+    Lookup get(const std::string& key);
+
+    // Store or replace a response, fresh for ttl and then served stale for
+    // up to stale more. Returns false if it is too large to keep.
+    bool put(const std::string& key,
+             std::shared_ptr<CachedResponse const> response,
+             std::chrono::milliseconds ttl,
+             std::chrono::milliseconds stale);
+
+    // A rebuild that get() asked for produced nothing to put(); the next
+    // stale hit asks again.
+    void refresh_failed(const std::string& key);
+
+    // Drop every entry whose key starts with prefix; an empty prefix drops
+    // everything. Returns the number dropped.
+    std::size_t purge(const std::string& prefix);
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        std::shared_ptr<CachedResponse const> response;
+        std::size_t bytes;
+        std::chrono::steady_clock::time_point fresh_until;
+        std::chrono::steady_clock::time_point stale_until;
+        bool refreshing;
+        std::list<std::string>::iterator lru;
+    };
+
+    void erase(std::unordered_map<std::string, Entry>::iterator it);
+
+    std::size_t max_bytes_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_; // most recently used first
+    std::size_t bytes_ = 0;
+
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> stale_hits_{0};
+    std::atomic<std::uint64_t> misses_{0};
+    std::atomic<std::uint64_t> evictions_{0};
+};
+
+#endif // RESPONSE_CACHE_HPP
@@ -0,0 +1,75 @@
+#ifndef WATCHER_HPP
+#define WATCHER_HPP
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// The Watcher class reports changes to files using inotify. Directories are
+// watched rather than files, so replacing a file by rename is seen as well
+// as writing to it in place. Events are read on a background thread and
+// passed to every subscriber as the full path of the changed entry; an
+// empty path means events were lost, or a directory was moved or removed,
+// and anything may have changed.
+//
+// A whole tree can be watched, in which case directories created or moved
+// into it are watched as they appear.
+//
+// If inotify is unavailable the Watcher does nothing, and caches relying on
+// it fall back to their own expiry.
+class Watcher {
+public:
+    // complete is true once the entry has been fully written: closed after
+    // writing, renamed into place, or found in a new directory.
+    using Callback = std::function<void(const std::string& path, bool complete)>;
+
+    // Constructor: starts the background thread.
+    Watcher();
+
+    // Destructor: stops the background thread.
+    ~Watcher();
+
+    // Watch a directory for changes to its entries. Idempotent.
+    void watch_directory(const std::string& dir);
+
+    // Watch the directory that contains path.
+    void watch_parent(const std::string& path);
+
+    // Watch a directory and every directory below it, including ones
+    // created later. Returns the number of directories watched.
+    std::size_t watch_tree(const std::string& root);
+
+    // Register a callback run on the watcher thread for every change.
+    void subscribe(Callback callback);
+
+    // Returns true if inotify could be initialised.
+    bool active() const;
+
+private:
+    struct Directory {
+        std::string path;
+        bool tree;
+    };
+
+    Watcher(const Watcher&) = delete;
+    Watcher& operator=(const Watcher&) = delete;
+
+    bool add(const std::string& dir, bool tree);
+    void run();
+    void notify(const std::string& path, bool complete);
+
+    int fd_;
+    int wake_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::unordered_map<int, Directory> directories_; // by watch descriptor
+    std::unordered_set<std::string> watched_;
+    std::vector<Callback> subscribers_;
+};
+
+#endif // WATCHER_HPP
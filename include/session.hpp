@@ -11,6 +11,7 @@
 
 class session : public std::enable_shared_from_this<session>
 {
+    std::shared_ptr<boost::asio::ssl::context> ctx_;
     boost::beast::ssl_stream<boost::beast::tcp_stream> stream_;
     boost::beast::flat_buffer buffer_;
     std::shared_ptr<std::string const> doc_root_;
@@ -19,7 +20,7 @@ class session : public std::enable_shared_from_this<session>
     public:
     session(
             boost::asio::ip::tcp::socket&& socket,
-            boost::asio::ssl::context& ctx,
+            std::shared_ptr<boost::asio::ssl::context> ctx,
             std::shared_ptr<std::string const> const& doc_root,
             std::shared_ptr<Application> app);
 
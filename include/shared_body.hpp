@@ -0,0 +1,53 @@
+#ifndef SHARED_BODY_HPP
+#define SHARED_BODY_HPP
+
+#include "beast.hpp"
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// A response body referring to immutable bytes owned elsewhere. The owner
+// is reference counted, so one buffer can be written to any number of
+// connections at once without being copied.
+struct shared_body
+{
+    struct value_type
+    {
+        std::shared_ptr<void const> owner;
+        char const* data = nullptr;
+        std::size_t size = 0;
+    };
+
+    static std::uint64_t size(value_type const& body)
+    {
+        return body.size;
+    }
+
+    class writer
+    {
+        value_type const& body_;
+
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        template<bool isRequest, class Fields>
+        writer(http::header<isRequest, Fields> const&, value_type const& body)
+            : body_(body)
+        {
+        }
+
+        void init(beast::error_code& ec)
+        {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec)
+        {
+            ec = {};
+            return {{const_buffers_type(body_.data, body_.size), false}};
+        }
+    };
+};
+
+#endif // SHARED_BODY_HPP
@@ -0,0 +1,65 @@
+#ifndef SINGLEFLIGHT_HPP
+#define SINGLEFLIGHT_HPP
+
+#include <exception>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+// Collapses concurrent calls for the same key into one: the first caller
+// runs the function, and callers arriving while it runs wait for it and
+// receive the same result, or the same exception. Nothing is remembered
+// once the call finishes; caching the result is up to the caller. The
+// function must not call run() for its own key.
+template<class Key, class Value, class Hash = std::hash<Key>>
+class singleflight
+{
+public:
+    // Returns the result, and sets shared if it came from another caller
+    template<class Fn>
+    Value run(Key const& key, Fn&& fn, bool* shared = nullptr)
+    {
+        std::promise<Value> promise;
+        std::shared_future<Value> future;
+        bool leader = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = calls_.find(key);
+            if(it != calls_.end())
+            {
+                future = it->second;
+            }
+            else
+            {
+                future = promise.get_future().share();
+                calls_.emplace(key, future);
+                leader = true;
+            }
+        }
+        if(shared)
+            *shared = ! leader;
+        if(! leader)
+            return future.get();
+
+        try
+        {
+            promise.set_value(fn());
+        }
+        catch(...)
+        {
+            promise.set_exception(std::current_exception());
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            calls_.erase(key);
+        }
+        return future.get();
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<Key, std::shared_future<Value>, Hash> calls_;
+};
+
+#endif // SINGLEFLIGHT_HPP
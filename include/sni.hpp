@@ -0,0 +1,45 @@
+#ifndef SNI_HPP
+#define SNI_HPP
+
+#include "beast.hpp"
+#include <boost/asio/ssl.hpp>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Preloaded SSL contexts for virtual hosts, selected per handshake from
+// the client's SNI hostname. Handshakes without SNI, or for unknown hosts,
+// continue with the default context the map is attached to.
+//
+// The configuration file has one certificate per line:
+//
+//     # host            certificate chain          private key
+//     example.com       /etc/tls/example-ec.pem    /etc/tls/example-ec.key
+//     example.com       /etc/tls/example-rsa.pem   /etc/tls/example-rsa.key
+//     *.example.org     /etc/tls/org.pem           /etc/tls/org.key
+//
+// Listing a host more than once loads each certificate into the same
+// context, so an ECDSA and an RSA certificate can be served side by side.
+// OpenSSL then presents the ECDSA one to every client that supports it.
+class sni_map
+{
+    std::unordered_map<std::string, std::shared_ptr<boost::asio::ssl::context>> exact_;
+    std::unordered_map<std::string, std::shared_ptr<boost::asio::ssl::context>> wildcard_;
+public:
+    // Load every context listed in the file; throws on any error.
+    static std::shared_ptr<sni_map> load(std::string const& path, std::string const& password);
+
+    // The context for a hostname: an exact match first, then "*.parent".
+    boost::asio::ssl::context* find(beast::string_view host) const;
+
+    // Install the servername callback on the default context. The map must
+    // outlive the context.
+    void attach(boost::asio::ssl::context& ctx) const;
+
+    std::size_t size() const;
+
+private:
+    static int on_servername(SSL* ssl, int* alert, void* arg);
+};
+
+#endif // SNI_HPP
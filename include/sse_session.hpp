@@ -0,0 +1,67 @@
+#ifndef SSE_SESSION_HPP
+#define SSE_SESSION_HPP
+
+#include "beast.hpp"
+#include "http_tools.hpp"
+#include "services/broadcast.hpp"
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/asio.hpp>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+
+// Streams text/event-stream responses for a Broadcast channel. A session
+// hands its stream over to this class once it reads a request for a
+// channel, and the response is kept open until the client goes away, it
+// falls too far behind, or the server shuts down.
+class sse_session
+    : public Broadcast::Subscriber
+    , public std::enable_shared_from_this<sse_session>
+{
+    boost::beast::ssl_stream<boost::beast::tcp_stream> stream_;
+    std::shared_ptr<Broadcast> broadcast_;
+    boost::beast::http::response<boost::beast::http::empty_body> res_;
+    boost::beast::http::response_serializer<boost::beast::http::empty_body> sr_;
+    std::deque<Broadcast::Buffer> queue_;
+    std::atomic<std::size_t> pending_{0};
+    boost::asio::steady_timer ping_;
+    bool writing_ = false;
+    bool closing_ = false;
+    public:
+    sse_session(
+            boost::beast::ssl_stream<boost::beast::tcp_stream>&& stream,
+            std::shared_ptr<Broadcast> broadcast);
+
+    template <class Body, class Allocator>
+    void run(boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> const& req);
+
+    bool deliver(Broadcast::Buffer const& event) override;
+    void close() override;
+
+    private:
+    void prepare_header();
+    void start(std::string target);
+    void on_header(boost::beast::error_code ec, std::size_t bytes_transferred);
+    void do_ping();
+    void push(Broadcast::Buffer event);
+    void do_write();
+    void on_write(boost::beast::error_code ec, std::size_t bytes_transferred);
+    void do_close();
+    void on_close(boost::beast::error_code ec, std::size_t bytes_transferred);
+    void on_shutdown(boost::beast::error_code ec);
+};
+
+template <class Body, class Allocator>
+void sse_session::run(boost::beast::http::request<Body, boost::beast::http::basic_fields<Allocator>> const& req)
+{
+    res_.version(req.version());
+    res_.result(boost::beast::http::status::ok);
+    prepare_header();
+    decorate_response(res_.base(), req);
+    start(std::string(req.target()));
+}
+
+#endif // SSE_SESSION_HPP
@@ -0,0 +1,34 @@
+#ifndef UPGRADE_HPP
+#define UPGRADE_HPP
+
+#include "beast.hpp"
+#include <boost/asio.hpp>
+#include <functional>
+
+// Zero-downtime binary upgrade. The running process execs a fresh copy of
+// the binary which inherits the listening socket, so the kernel keeps
+// queueing connections throughout and none are refused. The new process
+// reports readiness over a pipe, after which the old one drains and exits.
+
+// Record the path of the binary to exec on upgrade: UPGRADE_BINARY if set,
+// else the path this process was started from. Call once at startup,
+// before the binary can be replaced.
+void remember_executable();
+
+// Returns the listening socket inherited from the previous process, or -1.
+int inherited_listen_fd();
+
+// Tell the previous process that this one is accepting connections.
+void notify_upgrade_ready();
+
+// Exec the binary now at the remembered path with the same arguments,
+// handing it
+// listen_fd. on_ready(true) runs once the new process is accepting;
+// on_ready(false) if it could not be started or exited before that.
+void start_upgrade(
+    boost::asio::io_context& ioc,
+    int listen_fd,
+    char* argv[],
+    std::function<void(bool)> on_ready);
+
+#endif // UPGRADE_HPP
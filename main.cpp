@@ -1,11 +1,14 @@
 #include "include/server_certificate.hpp"
+#include "include/context_holder.hpp"
 #include "include/http_tools.hpp"
 #include "include/listener.hpp"
 #include "include/application.hpp"
+#include "include/upgrade.hpp"
 #include "include/services/test.hpp"
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
 #include <boost/asio/ssl.hpp>
+#include <functional>
 #include <iostream>
 #include <string>
 #include <memory>
@@ -25,25 +28,127 @@ int main(int argc, char* argv[])
     auto const address = net::ip::make_address(argv[1]);
     auto const port = static_cast<unsigned short>(std::atoi(argv[2]));
     auto const doc_root = std::make_shared<std::string>(argv[3]);
+
+    // Upgrades exec whatever binary is at this path by then
+    remember_executable();
     auto const threads = std::max<int>(1, std::atoi(argv[4]));
     
     // Initialize the io_context
     net::io_context ioc{threads};
 
-    // Initialize SSL context
-    ssl::context ctx{ssl::context::tlsv12};
-    load_server_certificate(ctx);
+    // PLAINTEXT=1 serves HTTP without TLS, for use behind a proxy that
+    // terminates it; large static files then go out with sendfile
+    load_environment();
+    bool const plaintext = std::getenv("PLAINTEXT") != nullptr;
+
+    // MIME_TYPES names a mime.types file extending the built-in table
+    if(char const* mime_types = std::getenv("MIME_TYPES"))
+        load_mime_types(mime_types);
+
+    // HEADER_RULES names a file of per-path response headers
+    if(char const* header_rules = std::getenv("HEADER_RULES"))
+        load_header_rules(header_rules);
+
+    // Initialize SSL context, reloaded on SIGHUP or when the files change
+    std::shared_ptr<context_holder> ctx;
+    if(! plaintext)
+    {
+        ctx = std::make_shared<context_holder>(ioc);
+        ctx->watch(std::chrono::seconds(5));
+    }
 
     // Initialize the Application with the shared io_context and SSL context
-    auto app = std::make_shared<Application>(ioc, ctx);
+    auto const client_ctx = plaintext
+        ? std::make_shared<ssl::context>(ssl::context::tlsv12_client)
+        : ctx->get();
+    auto app = std::make_shared<Application>(ioc, *client_ctx);
+
+    // BUNDLE names an archive built by tools/pack_bundle.cpp, served ahead
+    // of doc_root
+    if(char const* bundle = std::getenv("BUNDLE"))
+        app->load_bundle(bundle);
+
+    // Push changes under doc_root into the file caches; PREWARM=1 also
+    // loads small files ahead of the first request for them
+    app->watch_doc_root(*doc_root, std::getenv("PREWARM") != nullptr);
+
+    // FINGERPRINT=1 serves /app.<hash>.js for /app.js with immutable
+    // caching and links pages to those URLs
+    if(std::getenv("FINGERPRINT"))
+        app->fingerprint_doc_root(*doc_root);
 
-    // Start the listener to accept incoming connections
-    std::make_shared<listener>(
-        ioc,
-        ctx,
-        tcp::endpoint{address, port},
-        doc_root,
-        app)->run();
+    // Register the Server-Sent Events channels served alongside the routes
+    app->get_broadcast()->add_channel("/events");
+
+    // Start the listener to accept incoming connections, reusing the
+    // listening socket of the previous process after a hot upgrade
+    int const inherited = inherited_listen_fd();
+    auto const server = inherited >= 0
+        ? std::make_shared<listener>(
+            ioc,
+            ctx,
+            tcp::endpoint{address, port},
+            inherited,
+            doc_root,
+            app)
+        : std::make_shared<listener>(
+            ioc,
+            ctx,
+            tcp::endpoint{address, port},
+            doc_root,
+            app);
+    // Exiting closes the readiness pipe unwritten, so after an upgrade the
+    // previous process keeps serving
+    if(! server->listening())
+    {
+        Log::get().log(Level::ERROR, "[main] Not listening, exiting");
+        return EXIT_FAILURE;
+    }
+    server->run();
+    notify_upgrade_ready();
+
+    // Stop accepting, let in-flight requests finish with Connection: close,
+    // then stop the io_context
+    auto const drain = [&ioc, server, app]
+    {
+        server->stop();
+        app->begin_drain();
+        app->get_broadcast()->close_all();
+        app->wait_for_drain(std::chrono::seconds(30), [&ioc] { ioc.stop(); });
+    };
+
+    // SIGINT/SIGTERM drain and exit. SIGUSR2 execs a new copy of the binary
+    // that inherits the listening socket, and drains once it is accepting.
+    // SIGHUP reloads the certificate.
+    net::signal_set signals(ioc, SIGINT, SIGTERM, SIGUSR2);
+    signals.add(SIGHUP);
+    std::function<void()> wait_for_signal;
+    wait_for_signal = [&]
+    {
+        signals.async_wait(
+            [&](beast::error_code const& ec, int signal)
+            {
+                if(ec)
+                    return;
+                Log::get().log(Level::INFO, "[main] Received signal " + std::to_string(signal));
+                if(signal == SIGHUP)
+                {
+                    if(ctx)
+                        ctx->reload_async();
+                    return wait_for_signal();
+                }
+                if(signal != SIGUSR2)
+                    return drain();
+                start_upgrade(ioc, server->native_handle(), argv,
+                    [&](bool ready)
+                    {
+                        if(ready)
+                            return drain();
+                        wait_for_signal();
+                    });
+            });
+    };
+    wait_for_signal();
 
 //     // Initialize the Clock and Client services with the SSL context
 //     auto clock = std::make_shared<Clock>(ioc);
@@ -70,6 +175,9 @@ int main(int argc, char* argv[])
     // Run the I/O context in the main thread
     ioc.run();
 
+    for(auto& t : v)
+        t.join();
+
     return EXIT_SUCCESS;
 }
 
@@ -2,12 +2,89 @@
 #include "../include/services/clock.hpp"
 #include "../include/services/client.hpp"
 #include "../include/services/queue.hpp"
+#include "../include/services/broadcast.hpp"
+#include "../include/services/file_cache.hpp"
+#include "../include/services/watcher.hpp"
+#include "../include/services/fd_cache.hpp"
+#include "../include/services/negative_cache.hpp"
+#include "../include/services/fingerprints.hpp"
+#include "../include/services/response_cache.hpp"
+#include "../include/response_headers.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <sys/resource.h>
+#include <thread>
+
+namespace {
+
+// Raise the descriptor limit to the hard limit and size the descriptor
+// cache to half of it, leaving the rest for connections and everything
+// else. The default soft limit is often 1024, which a full cache would
+// exhaust on its own.
+std::size_t fd_cache_entries() {
+    struct rlimit limit;
+    if (::getrlimit(RLIMIT_NOFILE, &limit) != 0)
+        return 256;
+    if (limit.rlim_cur < limit.rlim_max) {
+        auto raised = limit;
+        raised.rlim_cur = limit.rlim_max;
+        if (::setrlimit(RLIMIT_NOFILE, &raised) == 0)
+            limit = raised;
+        else
+            Log::get().log(Level::WARN, "[Application] Could not raise the open file limit");
+    }
+    if (limit.rlim_cur == RLIM_INFINITY)
+        return 65536;
+    return static_cast<std::size_t>(std::clamp<rlim_t>(limit.rlim_cur / 2, 16, 65536));
+}
+
+} // namespace
+
 // Constructor implementation
-Application::Application(boost::asio::io_context& ioc, boost::asio::ssl::context& ssl_ctx) {
+Application::Application(boost::asio::io_context& ioc, boost::asio::ssl::context& ssl_ctx)
+    : drain_timer_(ioc), date_timer_(ioc) {
     log_ = std::make_shared<Log>();
     clock_ = std::make_shared<Clock>(ioc);
     client_ = std::make_shared<Client>(ioc, ssl_ctx); // Pass the SSL context to the Client
     queue_ = std::make_shared<Queue>(ioc, std::chrono::milliseconds(100), std::chrono::milliseconds(0));
+    broadcast_ = std::make_shared<Broadcast>();
+    file_cache_ = std::make_shared<FileCache>(64 * 1024 * 1024, 1024 * 1024, std::chrono::seconds(1));
+    watcher_ = std::make_shared<Watcher>();
+    fd_cache_ = std::make_shared<FdCache>(fd_cache_entries(), std::chrono::seconds(5), watcher_);
+    negative_cache_ = std::make_shared<NegativeCache>(4096, std::chrono::seconds(1));
+    fingerprints_ = std::make_shared<Fingerprints>();
+    response_cache_ = std::make_shared<ResponseCache>(16 * 1024 * 1024);
+
+    // The watcher thread may outlive the caches it reports to. A change to
+    // a precompressed sibling also changes what is served for its source.
+    std::weak_ptr<FileCache> file_cache = file_cache_;
+    std::weak_ptr<FdCache> fd_cache = fd_cache_;
+    std::weak_ptr<NegativeCache> negative_cache = negative_cache_;
+    watcher_->subscribe([file_cache, fd_cache, negative_cache](const std::string& path, bool) {
+        if (auto cache = fd_cache.lock())
+            cache->invalidate(path);
+        if (auto cache = negative_cache.lock())
+            cache->invalidate(path);
+        if (auto cache = file_cache.lock()) {
+            cache->invalidate(path);
+            auto const dot = path.rfind('.');
+            if (dot != std::string::npos && (path.compare(dot, 3, ".gz") == 0 || path.compare(dot, 3, ".br") == 0))
+                cache->invalidate(path.substr(0, dot));
+        }
+    });
+
+    tick_date();
+}
+
+void Application::tick_date() {
+    response_headers::tick();
+    auto const now = std::chrono::system_clock::now();
+    auto const next = std::chrono::ceil<std::chrono::seconds>(now + std::chrono::milliseconds(1));
+    date_timer_.expires_after(next - now);
+    date_timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (!ec)
+            tick_date();
+    });
 }
 std::shared_ptr<Log> Application::get_log() const { return log_; }
 
@@ -19,3 +96,128 @@ std::shared_ptr<Client> Application::get_client() const { return client_; }
 
 // Accessor for Queue
 std::shared_ptr<Queue> Application::get_queue() const { return queue_; }
+
+// Accessor for Broadcast
+std::shared_ptr<Broadcast> Application::get_broadcast() const { return broadcast_; }
+
+// Accessor for FileCache
+std::shared_ptr<FileCache> Application::get_file_cache() const { return file_cache_; }
+
+// Accessor for Watcher
+std::shared_ptr<Watcher> Application::get_watcher() const { return watcher_; }
+
+// Accessor for FdCache
+std::shared_ptr<FdCache> Application::get_fd_cache() const { return fd_cache_; }
+
+// Accessor for NegativeCache
+std::shared_ptr<NegativeCache> Application::get_negative_cache() const { return negative_cache_; }
+
+// Accessor for Fingerprints
+std::shared_ptr<Fingerprints> Application::get_fingerprints() const { return fingerprints_; }
+
+// Accessor for ResponseCache
+std::shared_ptr<ResponseCache> Application::get_response_cache() const { return response_cache_; }
+
+void Application::watch_doc_root(const std::string& doc_root, bool prewarm) {
+    std::size_t const directories = watcher_->watch_tree(doc_root);
+    if (directories == 0)
+        return;
+    Log::get().log(Level::INFO, "[Application] Watching " + std::to_string(directories) + " directories under: " + doc_root);
+
+    // Every change is pushed now, the timers only cover lost events
+    file_cache_->set_revalidate(std::chrono::seconds(60));
+    fd_cache_->set_ttl(std::chrono::seconds(60));
+    negative_cache_->set_revalidate(std::chrono::seconds(60));
+
+    if (!prewarm)
+        return;
+
+    // Reload rewritten files on the watcher thread, after the caches have
+    // dropped the old version
+    std::weak_ptr<FileCache> file_cache = file_cache_;
+    watcher_->subscribe([file_cache](const std::string& path, bool complete) {
+        if (!complete)
+            return;
+        if (auto cache = file_cache.lock())
+            cache->get(path);
+    });
+
+    // Load what is already there without delaying the first accept
+    std::thread([cache = file_cache_, doc_root] {
+        std::size_t loaded = 0;
+        std::error_code ec;
+        std::filesystem::recursive_directory_iterator it(
+            doc_root, std::filesystem::directory_options::skip_permission_denied, ec);
+        for (; !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            if (it->is_regular_file(ec) && cache->get(it->path().string()))
+                ++loaded;
+        }
+        Log::get().log(Level::INFO, "[Application] Prewarmed " + std::to_string(loaded) + " file(s) under: " + doc_root);
+    }).detach();
+}
+
+void Application::fingerprint_doc_root(const std::string& doc_root) {
+    fingerprints_->build(doc_root);
+    std::weak_ptr<Fingerprints> fingerprints = fingerprints_;
+    watcher_->subscribe([fingerprints](const std::string& path, bool complete) {
+        if (auto manifest = fingerprints.lock())
+            manifest->update(path, complete);
+    });
+}
+
+bool Application::load_bundle(const std::string& path) {
+    auto bundle = asset_bundle::open(path);
+    if (!bundle)
+        return false;
+    std::atomic_store(&bundle_, bundle);
+
+    // Deploys rename a new bundle over the old one; responses still
+    // writing from the old mapping keep it alive until they finish. The
+    // watcher names files in the current directory as ./name.
+    std::string const watched = path.find('/') == std::string::npos ? "./" + path : path;
+    watcher_->watch_parent(watched);
+    watcher_->subscribe([this, path, watched](const std::string& changed, bool complete) {
+        if (complete && changed == watched) {
+            if (auto next = asset_bundle::open(path))
+                std::atomic_store(&bundle_, next);
+        }
+    });
+    return true;
+}
+
+std::shared_ptr<asset_bundle const> Application::get_bundle() const {
+    return std::atomic_load(&bundle_);
+}
+
+void Application::begin_drain() {
+    draining_ = true;
+    Log::get().log(Level::INFO, "[Application] Draining: " + std::to_string(in_flight_.load()) + " request(s) in flight");
+}
+
+bool Application::draining() const { return draining_; }
+
+void Application::request_started() { ++in_flight_; }
+
+void Application::request_finished() { --in_flight_; }
+
+void Application::wait_for_drain(std::chrono::milliseconds deadline, std::function<void()> on_drained) {
+    poll_drain(std::chrono::steady_clock::now() + deadline, std::move(on_drained));
+}
+
+// Poll rather than signal so the hot path only pays for two atomic counters
+void Application::poll_drain(std::chrono::steady_clock::time_point deadline, std::function<void()> on_drained) {
+    if (queue_->idle() && in_flight_ == 0) {
+        Log::get().log(Level::INFO, "[Application] Drain complete");
+        return on_drained();
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+        Log::get().log(Level::WARN, "[Application] Drain deadline reached with " + std::to_string(in_flight_.load()) + " request(s) in flight");
+        return on_drained();
+    }
+    drain_timer_.expires_after(std::chrono::milliseconds(50));
+    drain_timer_.async_wait([this, deadline, on_drained](const boost::system::error_code& ec) {
+        if (!ec) {
+            poll_drain(deadline, on_drained);
+        }
+    });
+}
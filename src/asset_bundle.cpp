@@ -0,0 +1,111 @@
+#include "../include/asset_bundle.hpp"
+#include "../include/services/log.hpp"
+#include <cstring>
+#include <sys/stat.h>
+
+namespace {
+
+bool within(bundle_format::span const& s, std::size_t size)
+{
+    return s.offset <= size && s.size <= size - s.offset;
+}
+
+} // namespace
+
+std::shared_ptr<asset_bundle const> asset_bundle::open(std::string const& path)
+{
+    struct stat st;
+    if(::stat(path.c_str(), &st) != 0)
+    {
+        Log::get().log(Level::ERROR, "[asset_bundle] Cannot stat: " + path);
+        return nullptr;
+    }
+    auto file = mapped_file::open(path, st);
+    if(! file)
+    {
+        Log::get().log(Level::ERROR, "[asset_bundle] Cannot map: " + path);
+        return nullptr;
+    }
+
+    // Check every span once here, so lookups need no bounds checks
+    auto const size = file->size();
+    bundle_format::header header;
+    if(size < sizeof(header))
+    {
+        Log::get().log(Level::ERROR, "[asset_bundle] Truncated bundle: " + path);
+        return nullptr;
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    if(std::memcmp(header.magic, bundle_format::magic, sizeof(header.magic)) != 0 ||
+       header.count > (size - sizeof(header)) / sizeof(bundle_format::record))
+    {
+        Log::get().log(Level::ERROR, "[asset_bundle] Not a bundle: " + path);
+        return nullptr;
+    }
+
+    auto bundle = std::make_shared<asset_bundle>(std::move(file));
+    bundle->records_ = reinterpret_cast<bundle_format::record const*>(bundle->file_->data() + sizeof(header));
+    bundle->count_ = static_cast<std::size_t>(header.count);
+    for(std::size_t i = 0; i < bundle->count_; ++i)
+    {
+        auto const& r = bundle->records_[i];
+        for(auto const* s : {&r.path, &r.content_type, &r.etag, &r.gzip_etag, &r.last_modified, &r.data, &r.gzip})
+        {
+            if(! within(*s, size))
+            {
+                Log::get().log(Level::ERROR, "[asset_bundle] Corrupt record " + std::to_string(i) + " in: " + path);
+                return nullptr;
+            }
+        }
+        if(i > 0 && ! (bundle->view(bundle->records_[i - 1].path) < bundle->view(r.path)))
+        {
+            Log::get().log(Level::ERROR, "[asset_bundle] Unsorted path table in: " + path);
+            return nullptr;
+        }
+    }
+
+    Log::get().log(Level::INFO, "[asset_bundle] Loaded " + std::to_string(bundle->count_) + " asset(s) from: " + path);
+    return bundle;
+}
+
+asset_bundle::asset_bundle(std::shared_ptr<mapped_file const> file)
+    : file_(std::move(file))
+{
+}
+
+boost::optional<asset_bundle::asset> asset_bundle::find(std::string_view path) const
+{
+    std::size_t lo = 0;
+    std::size_t hi = count_;
+    while(lo < hi)
+    {
+        auto const mid = lo + (hi - lo) / 2;
+        auto const key = view(records_[mid].path);
+        if(key < path)
+            lo = mid + 1;
+        else if(path < key)
+            hi = mid;
+        else
+            return at(mid);
+    }
+    return boost::none;
+}
+
+std::string_view asset_bundle::view(bundle_format::span const& s) const
+{
+    return {file_->data() + s.offset, static_cast<std::size_t>(s.size)};
+}
+
+asset_bundle::asset asset_bundle::at(std::size_t index) const
+{
+    auto const& r = records_[index];
+    return asset{
+        view(r.path),
+        view(r.content_type),
+        view(r.etag),
+        view(r.gzip_etag),
+        view(r.last_modified),
+        view(r.data),
+        view(r.gzip),
+        r.mtime};
+}
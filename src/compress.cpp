@@ -0,0 +1,41 @@
+#include "../include/compress.hpp"
+#include <stdexcept>
+#include <zlib.h>
+
+bool compressible(beast::string_view content_type)
+{
+    auto const type = content_type.substr(0, content_type.find(';'));
+    if(beast::iequals(type.substr(0, 5), "text/"))
+        return true;
+    for(beast::string_view t : {
+            "application/json",
+            "application/javascript",
+            "application/xml",
+            "image/svg+xml"})
+        if(beast::iequals(type, t))
+            return true;
+    return false;
+}
+
+std::string gzip_compress(beast::string_view data, int level)
+{
+    z_stream zs{};
+    // 15 window bits plus 16 selects the gzip wrapper instead of zlib's
+    if(deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::runtime_error("deflateInit2 failed");
+
+    std::string out;
+    out.resize(deflateBound(&zs, static_cast<uLong>(data.size())));
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.size());
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = static_cast<uInt>(out.size());
+
+    int const result = deflate(&zs, Z_FINISH);
+    deflateEnd(&zs);
+    if(result != Z_STREAM_END)
+        throw std::runtime_error("deflate failed");
+
+    out.resize(zs.total_out);
+    return out;
+}
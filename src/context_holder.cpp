@@ -0,0 +1,97 @@
+#include "../include/context_holder.hpp"
+#include "../include/server_certificate.hpp"
+#include "../include/sni.hpp"
+#include "../include/services/log.hpp"
+#include <cstdlib>
+#include <thread>
+
+context_holder::context_holder(boost::asio::io_context& ioc)
+    : ctx_(build())
+    , timer_(ioc)
+{
+    for(char const* name : {"CERT_PATH", "KEY_PATH", "DH_PATH", "SNI_CONFIG"})
+        if(char const* path = std::getenv(name))
+            files_.emplace_back(path);
+    files_changed();
+}
+
+std::shared_ptr<boost::asio::ssl::context> context_holder::get() const
+{
+    return std::atomic_load(&ctx_);
+}
+
+bool context_holder::reload()
+{
+    try {
+        auto ctx = build();
+        std::atomic_store(&ctx_, std::move(ctx));
+        Log::get().log(Level::INFO, "[context_holder] Certificate reloaded");
+        return true;
+    } catch (const std::exception& e) {
+        Log::get().log(Level::ERROR, "[context_holder] Reload failed, keeping current certificate: " + std::string(e.what()));
+        return false;
+    }
+}
+
+void context_holder::reload_async()
+{
+    std::thread([self = shared_from_this()] { self->reload(); }).detach();
+}
+
+void context_holder::watch(std::chrono::seconds interval)
+{
+    timer_.expires_after(interval);
+    timer_.async_wait(
+        [self = shared_from_this(), interval](const boost::system::error_code& ec)
+        {
+            if(ec)
+                return;
+            // Wait until the files stop changing, so a certificate and key
+            // written one after the other are picked up together
+            if(self->files_changed())
+                self->changed_ = true;
+            else if(self->changed_)
+            {
+                self->changed_ = false;
+                self->reload_async();
+            }
+            self->watch(interval);
+        });
+}
+
+std::shared_ptr<boost::asio::ssl::context> context_holder::build()
+{
+    auto ctx = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tlsv12);
+    load_server_certificate(*ctx);
+
+    // Virtual hosts are optional and selected by SNI during the handshake
+    char const* sni_config = std::getenv("SNI_CONFIG");
+    if(! sni_config)
+        return ctx;
+
+    auto hosts = sni_map::load(sni_config, std::getenv("SSL_PASSWORD"));
+    hosts->attach(*ctx);
+
+    // The returned pointer owns the map too, so it lives exactly as long as
+    // the last session using this context
+    struct contexts
+    {
+        std::shared_ptr<boost::asio::ssl::context> ctx;
+        std::shared_ptr<sni_map> hosts;
+    };
+    auto owner = std::make_shared<contexts>(contexts{ctx, std::move(hosts)});
+    return std::shared_ptr<boost::asio::ssl::context>(owner, owner->ctx.get());
+}
+
+bool context_holder::files_changed()
+{
+    std::vector<std::filesystem::file_time_type> mtimes;
+    for(auto const& file : files_)
+    {
+        std::error_code ec;
+        mtimes.push_back(std::filesystem::last_write_time(file, ec));
+    }
+    bool const changed = mtimes != mtimes_;
+    mtimes_ = std::move(mtimes);
+    return changed;
+}
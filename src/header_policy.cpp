@@ -0,0 +1,93 @@
+#include "../include/header_policy.hpp"
+#include "../include/services/log.hpp"
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+std::string trim(std::string s)
+{
+    auto const first = s.find_first_not_of(" \t\r");
+    if(first == std::string::npos)
+        return {};
+    auto const last = s.find_last_not_of(" \t\r");
+    return s.substr(first, last - first + 1);
+}
+
+} // namespace
+
+std::shared_ptr<header_policy> header_policy::load(std::string const& path)
+{
+    std::ifstream file(path);
+    if(! file.is_open())
+        throw std::runtime_error("Could not open file: " + path);
+
+    auto policy = std::make_shared<header_policy>();
+    std::string line;
+    while(std::getline(file, line))
+    {
+        line = trim(line);
+        if(line.empty() || line[0] == '#')
+            continue;
+        auto const space = line.find_first_of(" \t");
+        auto const colon = line.find(':', space == std::string::npos ? line.size() : space);
+        if(space == std::string::npos || colon == std::string::npos)
+            throw std::runtime_error("Malformed line in " + path + ": " + line);
+        policy->add(
+            line.substr(0, space),
+            trim(line.substr(space, colon - space)),
+            trim(line.substr(colon + 1)));
+    }
+
+    Log::get().log(Level::INFO, "[header_policy] Loaded " + std::to_string(policy->size()) + " rule(s) from " + path);
+    return policy;
+}
+
+void header_policy::add(std::string const& pattern, std::string const& name, std::string const& value)
+{
+    if(name.empty() || name.find_first_of(" \t") != std::string::npos)
+        throw std::runtime_error("Malformed header name: " + name);
+
+    rule r;
+    std::string literal;
+    auto const star = pattern.find('*');
+    if(star == std::string::npos)
+    {
+        literal = pattern;
+        r.type = ! pattern.empty() && pattern.back() == '/' ? rule::kind::prefix : rule::kind::exact;
+    }
+    else
+    {
+        literal = pattern.substr(0, star);
+        r.suffix = pattern.substr(star + 1);
+        if(r.suffix.find('*') != std::string::npos)
+            throw std::runtime_error("Only one '*' is allowed in a pattern: " + pattern);
+        r.type = r.suffix.empty() ? rule::kind::prefix : rule::kind::glob;
+    }
+
+    r.h.field = http::string_to_field(name);
+    r.h.name = name;
+    r.h.value = value;
+    r.h.caching = r.h.field == http::field::cache_control || r.h.field == http::field::expires;
+
+    // Extend the trie along the literal prefix
+    std::uint32_t current = 0;
+    for(char c : literal)
+    {
+        auto& children = nodes_[current].children;
+        auto it = std::find_if(children.begin(), children.end(),
+            [c](std::pair<char, std::uint32_t> const& child) { return child.first == c; });
+        if(it != children.end())
+        {
+            current = it->second;
+            continue;
+        }
+        auto const next = static_cast<std::uint32_t>(nodes_.size());
+        nodes_[current].children.emplace_back(c, next);
+        nodes_.emplace_back();
+        current = next;
+    }
+
+    nodes_[current].rules.push_back(static_cast<std::uint32_t>(rules_.size()));
+    rules_.push_back(std::move(r));
+}
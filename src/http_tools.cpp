@@ -1,6 +1,142 @@
 #include "../include/application.hpp"
 #include "../include/http_tools.hpp"
+#include "../include/shared_body.hpp"
+#include "../include/compress.hpp"
+#include "../include/range_body.hpp"
+#include "../include/mapped_file.hpp"
+#include "../include/asset_bundle.hpp"
+#include "../include/header_policy.hpp"
+#include "../include/route_table.hpp"
+#include "../include/response_headers.hpp"
+#include "../include/middleware.hpp"
+#include "../include/mime_table.hpp"
 #include "../include/services/log.hpp"  // Include the Log service
+#include <boost/optional.hpp>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <ctime>
+
+// Strong validator built from the file's identity, so no hashing is needed.
+// Each encoding of a file is a distinct representation and gets its own tag.
+static std::string make_etag(std::uint64_t inode, std::uint64_t size, std::int64_t mtime, beast::string_view encoding)
+{
+    char buf[80];
+    int n = std::snprintf(buf, sizeof(buf), "\"%llx-%llx-%llx",
+        static_cast<unsigned long long>(inode),
+        static_cast<unsigned long long>(size),
+        static_cast<unsigned long long>(mtime));
+    std::string etag(buf, n);
+    if (!encoding.empty())
+        etag.append("-").append(encoding.data(), encoding.size());
+    etag.push_back('"');
+    return etag;
+}
+
+// The canonical form of a target's path, which is what gets served: the
+// query dropped, no empty, "." or ".." segments, and nothing above the
+// root. A target naming a directory keeps a trailing slash.
+static std::string normalize_target(beast::string_view target)
+{
+    target = target.substr(0, target.find('?'));
+    bool const trailing = !target.empty() && target.back() == '/';
+    bool directory = false;
+    std::string path;
+    while (!target.empty()) {
+        auto const slash = target.find('/');
+        auto const segment = target.substr(0, slash);
+        target = slash == beast::string_view::npos ? beast::string_view{} : target.substr(slash + 1);
+        if (segment.empty())
+            continue;
+        if (segment == "." || segment == "..") {
+            if (segment == "..")
+                path.resize(std::min(path.size(), path.rfind('/')));
+            directory = true;
+        } else {
+            path.push_back('/');
+            path.append(segment.data(), segment.size());
+            directory = false;
+        }
+    }
+    if (directory || trailing || path.empty())
+        path.push_back('/');
+    return path;
+}
+
+// Rules loaded from HEADER_RULES at startup. Only written before the
+// server starts, so lookups need no lock.
+static std::shared_ptr<header_policy const> header_rules;
+
+// Middleware attaching the configured headers for the request path,
+// matched in the same canonical form the file is served by, so another
+// spelling of a path cannot dodge its rules. Caching headers only go on
+// successful and 304 responses.
+struct header_rules_stage
+{
+    template <class Request, class Fields>
+    void on_response(Request const& req, http::header<false, Fields>& res) const
+    {
+        if (!header_rules)
+            return;
+        bool const cacheable =
+            http::to_status_class(res.result()) == http::status_class::successful ||
+            res.result() == http::status::not_modified;
+        header_rules->apply(res, normalize_target(req.target()), cacheable);
+    }
+};
+
+// The middleware every request passes through; see middleware.hpp. Add
+// stages here.
+static pipeline<header_rules_stage> middleware;
+
+// Pass a response built by a handler back through the middleware
+template <class Fields, class Body, class Allocator>
+static void decorate(http::header<false, Fields>& res, http::request<Body, http::basic_fields<Allocator>> const& req)
+{
+    middleware.on_response(req, res);
+}
+
+// If-None-Match takes precedence; If-Modified-Since is only consulted
+// when it is absent.
+template <class Body, class Allocator>
+bool not_modified(
+        http::request<Body, http::basic_fields<Allocator>> const& req,
+        beast::string_view etag,
+        std::time_t modified)
+{
+    auto const inm = req[http::field::if_none_match];
+    if (!inm.empty()) {
+        if (inm == "*")
+            return true;
+        // Weak comparison: a W/ prefix on the client's copy is ignored
+        auto list = inm;
+        while (!list.empty()) {
+            auto const comma = list.find(',');
+            auto tag = list.substr(0, comma);
+            list = comma == beast::string_view::npos ? beast::string_view{} : list.substr(comma + 1);
+            while (!tag.empty() && tag.front() == ' ')
+                tag.remove_prefix(1);
+            while (!tag.empty() && tag.back() == ' ')
+                tag.remove_suffix(1);
+            if (tag.size() > 2 && tag[0] == 'W' && tag[1] == '/')
+                tag.remove_prefix(2);
+            if (tag == etag)
+                return true;
+        }
+        return false;
+    }
+
+    auto const ims = req[http::field::if_modified_since];
+    if (ims.empty())
+        return false;
+    std::tm tm{};
+    std::string const value(ims);
+    if (!strptime(value.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm))
+        return false;
+    return modified <= timegm(&tm);
+}
 
 template <class Body, class Allocator>
 http::response<http::string_body> send_(
@@ -10,24 +146,380 @@ http::response<http::string_body> send_(
         const std::string& content_type = "application/json")
 {
     http::response<http::string_body> res{status, req.version()};
-    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    response_headers::stamp(res);
     res.set(http::field::content_type, content_type);
     res.keep_alive(req.keep_alive());
-    res.body() = body;
+    decorate(res, req);
+    if (body.size() >= compress_min_size && compressible(content_type)) {
+        response_headers::vary(res, "Accept-Encoding");
+        if (accepted_encodings(req[http::field::accept_encoding]) & FileCache::gzip) {
+            res.set(http::field::content_encoding, "gzip");
+            res.body() = gzip_compress(body);
+        } else {
+            res.body() = body;
+        }
+    } else {
+        res.body() = body;
+    }
     res.prepare_payload();
     Log::get().log(Level::INFO, "[handle_request] Sending response: " + std::string(res.reason()));
     return res;
 }
 
 template <class Body, class Allocator>
-http::message_generator handle_post_request(
-        http::request<Body, http::basic_fields<Allocator>>&& req,
-        std::shared_ptr<Application> app)
+http::response<http::string_body> handle_post_request(
+        http::request<Body, http::basic_fields<Allocator>> const& req)
 {
     Log::get().log(Level::INFO, "[handle_post_request] Processing POST request");
     return send_(req, http::status::ok, R"({"message": "POST request processed"})");
 }
 
+// What handle_get_request resolved a request target to
+struct static_file
+{
+    std::string path;               // file to send, possibly a precompressed sibling
+    beast::string_view content_type; // from the requested path, not the sibling
+    beast::string_view encoding;     // Content-Encoding, empty for identity
+    bool vary;                       // the response depends on Accept-Encoding
+    std::string etag;
+    std::string last_modified;
+    beast::string_view cache_control; // empty to leave caching to the client
+
+    // Fill in the validators from the file's metadata
+    void validators(std::uint64_t inode, std::uint64_t size, std::int64_t mtime)
+    {
+        etag = make_etag(inode, size, mtime, encoding);
+        last_modified = response_headers::http_date(static_cast<std::time_t>(mtime / 1000000000));
+    }
+};
+
+// Headers common to every static file response
+template <class ResBody, class Body, class Allocator>
+void set_file_headers(
+        http::response<ResBody>& res,
+        http::request<Body, http::basic_fields<Allocator>> const& req,
+        static_file const& file,
+        std::uint64_t size)
+{
+    response_headers::stamp(res);
+    res.set(http::field::content_type, file.content_type);
+    if (!file.encoding.empty())
+        res.set(http::field::content_encoding, file.encoding);
+    if (file.vary)
+        response_headers::vary(res, "Accept-Encoding");
+    if (!file.etag.empty()) {
+        res.set(http::field::etag, file.etag);
+        res.set(http::field::last_modified, file.last_modified);
+    }
+    decorate(res, req);
+    if (!file.cache_control.empty())
+        res.set(http::field::cache_control, file.cache_control);
+    res.set(http::field::accept_ranges, "bytes");
+    res.content_length(size);
+    res.keep_alive(req.keep_alive());
+}
+
+// 404 for a missing static file. The response is built once and copied,
+// since scanners can ask for the same missing paths many times a second.
+template <class Body, class Allocator>
+http::message_generator send_not_found(
+        http::request<Body, http::basic_fields<Allocator>> const& req)
+{
+    static http::response<http::string_body> const prototype = [] {
+        http::response<http::string_body> res{http::status::not_found, 11};
+        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+        res.set(http::field::content_type, "application/json");
+        res.body() = "The resource was not found.";
+        res.prepare_payload();
+        return res;
+    }();
+    auto res = prototype;
+    res.version(req.version());
+    res.set(http::field::date, response_headers::date());
+    res.keep_alive(req.keep_alive());
+    decorate(res, req);
+    return res;
+}
+
+// 304 for a client whose copy is still current; only validators are sent
+template <class Body, class Allocator>
+http::message_generator send_not_modified(
+        http::request<Body, http::basic_fields<Allocator>> const& req,
+        static_file const& file)
+{
+    http::response<http::empty_body> res{http::status::not_modified, req.version()};
+    response_headers::stamp(res);
+    if (file.vary)
+        response_headers::vary(res, "Accept-Encoding");
+    res.set(http::field::etag, file.etag);
+    res.set(http::field::last_modified, file.last_modified);
+    decorate(res, req);
+    if (!file.cache_control.empty())
+        res.set(http::field::cache_control, file.cache_control);
+    res.keep_alive(req.keep_alive());
+    return res;
+}
+
+// An inclusive byte range of the selected representation
+struct byte_range
+{
+    std::uint64_t first;
+    std::uint64_t last;
+};
+
+// Parse a "bytes=" Range header against a representation of the given
+// size. Returns false when the header should be ignored: a unit or syntax
+// we do not handle, or more ranges than are worth the multipart overhead.
+// Unsatisfiable ranges are skipped, so an empty result means 416.
+static bool parse_ranges(beast::string_view header, std::uint64_t size, std::vector<byte_range>& ranges)
+{
+    constexpr std::size_t max_ranges = 16;
+
+    if (header.substr(0, 6) != "bytes=")
+        return false;
+    header.remove_prefix(6);
+
+    auto const number = [](beast::string_view s, std::uint64_t& out) {
+        if (s.empty() || s.size() > 19)
+            return false;
+        out = 0;
+        for (char c : s) {
+            if (c < '0' || c > '9')
+                return false;
+            out = out * 10 + static_cast<std::uint64_t>(c - '0');
+        }
+        return true;
+    };
+
+    while (!header.empty()) {
+        auto const comma = header.find(',');
+        auto spec = header.substr(0, comma);
+        header = comma == beast::string_view::npos ? beast::string_view{} : header.substr(comma + 1);
+        while (!spec.empty() && spec.front() == ' ')
+            spec.remove_prefix(1);
+        while (!spec.empty() && spec.back() == ' ')
+            spec.remove_suffix(1);
+
+        auto const dash = spec.find('-');
+        if (dash == beast::string_view::npos)
+            return false;
+        std::uint64_t first = 0, last = 0;
+        if (dash == 0) {
+            // "-n": the final n bytes
+            if (!number(spec.substr(1), last))
+                return false;
+            if (last == 0 || size == 0)
+                continue;
+            first = last >= size ? 0 : size - last;
+            last = size - 1;
+        } else {
+            if (!number(spec.substr(0, dash), first))
+                return false;
+            if (dash + 1 == spec.size())
+                last = size - 1;
+            else if (!number(spec.substr(dash + 1), last) || last < first)
+                return false;
+            if (first >= size)
+                continue;
+            last = std::min(last, size - 1);
+        }
+
+        if (ranges.size() == max_ranges)
+            return false;
+        ranges.push_back({first, last});
+    }
+    return true;
+}
+
+// The ranges to send, or none when the whole representation goes out with
+// 200: no Range header, an If-Range that no longer matches, or a header we
+// choose to ignore.
+template <class Body, class Allocator>
+boost::optional<std::vector<byte_range>> requested_ranges(
+        http::request<Body, http::basic_fields<Allocator>> const& req,
+        static_file const& file,
+        std::uint64_t size)
+{
+    auto const range = req[http::field::range];
+    if (range.empty() || req.method() != http::verb::get)
+        return boost::none;
+
+    // If-Range holds either a strong ETag or the Last-Modified date
+    auto const if_range = req[http::field::if_range];
+    if (!if_range.empty() && if_range != file.etag && if_range != file.last_modified)
+        return boost::none;
+
+    std::vector<byte_range> ranges;
+    if (!parse_ranges(range, size, ranges))
+        return boost::none;
+    return ranges;
+}
+
+// 206 with one slice, or multipart/byteranges for several; 416 when no
+// range can be satisfied. slice(offset, length) produces the body slices.
+template <class Body, class Allocator, class Slice>
+http::message_generator send_ranges(
+        http::request<Body, http::basic_fields<Allocator>> const& req,
+        static_file const& file,
+        std::uint64_t size,
+        std::vector<byte_range> const& ranges,
+        Slice slice)
+{
+    if (ranges.empty()) {
+        http::response<http::empty_body> res{http::status::range_not_satisfiable, req.version()};
+        response_headers::stamp(res);
+        res.set(http::field::content_range, "bytes */" + std::to_string(size));
+        decorate(res, req);
+        res.content_length(0);
+        res.keep_alive(req.keep_alive());
+        return res;
+    }
+
+    auto const content_range = [size](byte_range const& r) {
+        return "bytes " + std::to_string(r.first) + "-" + std::to_string(r.last) + "/" + std::to_string(size);
+    };
+    auto const text = [](std::string s) {
+        auto owned = std::make_shared<std::string const>(std::move(s));
+        range_body::slice part;
+        part.data = owned->data();
+        part.size = owned->size();
+        part.owner = std::move(owned);
+        return part;
+    };
+
+    http::response<range_body> res{http::status::partial_content, req.version()};
+    set_file_headers(res, req, file, 0);
+    if (ranges.size() == 1) {
+        res.set(http::field::content_range, content_range(ranges.front()));
+        res.body().slices.push_back(slice(ranges.front().first, ranges.front().last - ranges.front().first + 1));
+    } else {
+        static char const boundary[] = "6f1c2a9e07b54d3d";
+        res.set(http::field::content_type, std::string("multipart/byteranges; boundary=") + boundary);
+        for (auto const& r : ranges) {
+            res.body().slices.push_back(text(
+                std::string("\r\n--") + boundary +
+                "\r\nContent-Type: " + std::string(file.content_type) +
+                "\r\nContent-Range: " + content_range(r) + "\r\n\r\n"));
+            res.body().slices.push_back(slice(r.first, r.last - r.first + 1));
+        }
+        res.body().slices.push_back(text(std::string("\r\n--") + boundary + "--\r\n"));
+    }
+    res.content_length(range_body::size(res.body()));
+    Log::get().log(Level::INFO, "[handle_get_request] Serving " + std::to_string(ranges.size()) + " range(s) of: " + file.path);
+    return res;
+}
+
+// The file under doc_root a target names, index.html for directories.
+// One spelling per file, matching the paths the Watcher reports, so cache
+// entries can be invalidated by its events.
+static std::string resolve_path(beast::string_view doc_root, beast::string_view target)
+{
+    while (!doc_root.empty() && doc_root.back() == '/')
+        doc_root.remove_suffix(1);
+    std::string path(doc_root);
+    path.append(normalize_target(target));
+    if (path.back() == '/')
+        path.append("index.html");
+    return path;
+}
+
+// Resolve a path to the file and representation to send, preferring a
+// precompressed sibling the client accepts, brotli first
+static static_file resolve_static_file(
+        std::string const& path,
+        FileCache& cache,
+        unsigned accepted)
+{
+    static_file file{path, mime_type(path), {}, false, {}, {}, {}};
+    unsigned const variants = cache.precompressed(path);
+    unsigned const usable = variants & accepted;
+    file.vary = variants != 0;
+    if (usable & FileCache::brotli) {
+        file.path = path + ".br";
+        file.encoding = "br";
+    } else if (usable & FileCache::gzip) {
+        file.path = path + ".gz";
+        file.encoding = "gzip";
+    }
+    return file;
+}
+
+// A fingerprinted URL always names the same bytes
+static constexpr char immutable_cache_control[] = "public, max-age=31536000, immutable";
+
+// The URL path behind a fingerprinted target, if it is a current one
+static boost::optional<std::string> unfingerprint(Fingerprints const& fingerprints, beast::string_view target)
+{
+    if (!fingerprints.active())
+        return boost::none;
+    auto const path = target.substr(0, target.find('?'));
+    return fingerprints.resolve(std::string_view(path.data(), path.size()));
+}
+
+// Bundle paths are request paths without the query, index.html for
+// directories
+static boost::optional<asset_bundle::asset> find_asset(asset_bundle const& bundle, beast::string_view target)
+{
+    std::string key(target.substr(0, target.find('?')));
+    if (!key.empty() && key.back() == '/')
+        key.append("index.html");
+    return bundle.find(key);
+}
+
+// Serve an asset as a slice of the bundle's mapping. Everything but the
+// choice of encoding was computed when the bundle was packed.
+template <class Body, class Allocator>
+http::message_generator send_asset(
+        http::request<Body, http::basic_fields<Allocator>> const& req,
+        std::shared_ptr<asset_bundle const> const& bundle,
+        asset_bundle::asset const& asset,
+        beast::string_view cache_control)
+{
+    static_file file{
+        std::string(asset.path),
+        beast::string_view(asset.content_type.data(), asset.content_type.size()),
+        {},
+        !asset.gzip.empty(),
+        std::string(asset.etag),
+        std::string(asset.last_modified),
+        cache_control};
+    auto body = asset.data;
+    if (!asset.gzip.empty() && (accepted_encodings(req[http::field::accept_encoding]) & FileCache::gzip)) {
+        file.encoding = "gzip";
+        file.etag.assign(asset.gzip_etag.data(), asset.gzip_etag.size());
+        body = asset.gzip;
+    }
+
+    if (not_modified(req, file.etag, static_cast<std::time_t>(asset.mtime / 1000000000)))
+        return send_not_modified(req, file);
+
+    if (auto ranges = requested_ranges(req, file, body.size())) {
+        return send_ranges(req, file, body.size(), *ranges,
+            [&bundle, body](std::uint64_t offset, std::uint64_t length) {
+                range_body::slice part;
+                part.owner = bundle;
+                part.data = body.data() + offset;
+                part.size = length;
+                return part;
+            });
+    }
+
+    if (req.method() == http::verb::head) {
+        http::response<http::empty_body> res{http::status::ok, req.version()};
+        set_file_headers(res, req, file, body.size());
+        return res;
+    }
+
+    Log::get().log(Level::INFO, "[handle_get_request] Serving bundled asset: " + file.path + " with size: " + std::to_string(body.size()));
+    http::response<shared_body> res{
+        std::piecewise_construct,
+            std::make_tuple(shared_body::value_type{bundle, body.data(), body.size()}),
+            std::make_tuple(http::status::ok, req.version())
+    };
+    set_file_headers(res, req, file, body.size());
+    return res;
+}
+
 template <class Body, class Allocator>
 http::message_generator handle_get_request(
         beast::string_view doc_root,
@@ -37,18 +529,165 @@ http::message_generator handle_get_request(
     Log::get().log(Level::INFO, "[handle_get_request] Processing GET request for target: " + std::string(req.target()));
 
     try {
-        std::string path = path_cat(doc_root, req.target());
-        if (req.target().back() == '/') {
-            path.append("index.html");
+        // A fingerprinted URL is served from the file it names, with a
+        // response that may be cached forever
+        auto const fingerprints = app->get_fingerprints();
+        auto const logical = unfingerprint(*fingerprints, req.target());
+        beast::string_view const target = logical ? beast::string_view(*logical) : req.target();
+        beast::string_view const cache_control = logical ? immutable_cache_control : "";
+
+        // Assets packed into the bundle never touch the disk; anything not
+        // in it falls through to doc_root
+        if (auto bundle = app->get_bundle()) {
+            if (auto asset = find_asset(*bundle, target))
+                return send_asset(req, bundle, *asset, cache_control);
+        }
+
+        // Paths that were missing last time are answered from memory
+        std::string const path = resolve_path(doc_root, target);
+        auto const negative = app->get_negative_cache();
+        if (negative->contains(path))
+            return send_not_found(req);
+        auto const negative_generation = negative->generation();
+
+        auto const cache = app->get_file_cache();
+        unsigned const accepted = accepted_encodings(req[http::field::accept_encoding]);
+        static_file file = resolve_static_file(path, *cache, accepted);
+        file.cache_control = cache_control;
+
+        // Pages link the current fingerprint of each asset, which a
+        // precompressed sibling cannot do
+        bool const rewrite = fingerprints->active() && file.content_type == "text/html";
+        if (rewrite && !file.encoding.empty()) {
+            file.path = path;
+            file.encoding = {};
+        }
+
+        // Small files are answered from memory without touching the disk.
+        // Compressible ones without a precompressed sibling are gzipped
+        // once per version on the cache's workers and the result is cached
+        // alongside; until it is ready they are sent uncompressed.
+        if (auto cached = cache->get(file.path)) {
+            bool gzip = false;
+            if (file.encoding.empty() && cached->size >= compress_min_size && compressible(file.content_type)) {
+                file.vary = true;
+                gzip = (accepted & FileCache::gzip) != 0;
+            }
+
+            Fingerprints::Page page;
+            if (rewrite)
+                page = fingerprints->rewrite(cached, normalize_target(target), gzip);
+            std::shared_ptr<CachedFile const> compressed;
+            if (gzip && !page.file && !(compressed = cache->gzipped(cached)))
+                gzip = false;
+            if (gzip)
+                file.encoding = "gzip";
+
+            // Validators come from the source, so a 304 needs no compression.
+            // A rewritten page also changes when the assets it links do.
+            file.validators(cached->inode, cached->size, cached->mtime);
+            if (!page.tag.empty())
+                file.etag.insert(file.etag.size() - 1, "-" + page.tag);
+            if (not_modified(req, file.etag, static_cast<std::time_t>(cached->mtime / 1000000000)))
+                return send_not_modified(req, file);
+            if (page.file)
+                cached = page.file;
+            else if (compressed)
+                cached = compressed;
+
+            if (auto ranges = requested_ranges(req, file, cached->size)) {
+                return send_ranges(req, file, cached->size, *ranges,
+                    [&cached](std::uint64_t offset, std::uint64_t length) {
+                        range_body::slice part;
+                        part.owner = cached->body;
+                        part.data = cached->body->data() + offset;
+                        part.size = length;
+                        return part;
+                    });
+            }
+
+            if (req.method() == http::verb::head) {
+                Log::get().log(Level::INFO, "[handle_get_request] HEAD request for cached: " + file.path);
+                http::response<http::empty_body> res{http::status::ok, req.version()};
+                set_file_headers(res, req, file, cached->size);
+                return res;
+            }
+
+            Log::get().log(Level::INFO, "[handle_get_request] Serving cached file: " + file.path + " with size: " + std::to_string(cached->size));
+            http::response<shared_body> res{
+                std::piecewise_construct,
+                    std::make_tuple(shared_body::value_type{cached->body, cached->body->data(), cached->body->size()}),
+                    std::make_tuple(http::status::ok, req.version())
+            };
+            set_file_headers(res, req, file, cached->size);
+            return res;
+        }
+
+        // Answer conditional requests from the metadata of the open file;
+        // recently served files need neither stat nor open
+        if (auto open = app->get_fd_cache()->get(file.path)) {
+            struct stat const& st = open->st;
+            file.validators(st.st_ino, st.st_size,
+                static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec);
+            if (not_modified(req, file.etag, st.st_mtim.tv_sec))
+                return send_not_modified(req, file);
+
+            // Larger files are served from a shared mmap; requests for the
+            // same file at the same time share one mapping
+            auto ranges = requested_ranges(req, file, st.st_size);
+            if (auto mapped = mapped_file::open(file.path, st, open->file->fd())) {
+                if (ranges) {
+                    return send_ranges(req, file, mapped->size(), *ranges,
+                        [&mapped](std::uint64_t offset, std::uint64_t length) {
+                            range_body::slice part;
+                            part.owner = mapped;
+                            part.data = mapped->data() + offset;
+                            part.size = length;
+                            return part;
+                        });
+                }
+
+                if (req.method() == http::verb::head) {
+                    Log::get().log(Level::INFO, "[handle_get_request] HEAD request for: " + file.path);
+                    http::response<http::empty_body> res{http::status::ok, req.version()};
+                    set_file_headers(res, req, file, mapped->size());
+                    return res;
+                }
+
+                Log::get().log(Level::INFO, "[handle_get_request] Serving mapped file: " + file.path + " with size: " + std::to_string(mapped->size()));
+                http::response<shared_body> res{
+                    std::piecewise_construct,
+                        std::make_tuple(shared_body::value_type{mapped, mapped->data(), mapped->size()}),
+                        std::make_tuple(http::status::ok, req.version())
+                };
+                set_file_headers(res, req, file, mapped->size());
+                return res;
+            }
+
+            // Without a mapping, ranges read only the requested regions with
+            // pread on the shared descriptor
+            if (ranges) {
+                return send_ranges(req, file, st.st_size, *ranges,
+                    [&open](std::uint64_t offset, std::uint64_t length) {
+                        range_body::slice part;
+                        part.file = open->file;
+                        part.offset = offset;
+                        part.size = length;
+                        return part;
+                    });
+            }
         }
 
         beast::error_code ec;
         http::file_body::value_type body;
-        body.open(path.c_str(), beast::file_mode::scan, ec);
+        body.open(file.path.c_str(), beast::file_mode::scan, ec);
 
         if (ec == beast::errc::no_such_file_or_directory) {
-            Log::get().log(Level::WARN, "[handle_get_request] Resource not found: " + path);
-            return send_(req, http::status::not_found, "The resource was not found.");
+            Log::get().log(Level::WARN, "[handle_get_request] Resource not found: " + file.path);
+            // A precompressed sibling that vanished says nothing about path
+            if (file.path == path)
+                negative->insert(path, negative_generation);
+            return send_not_found(req);
         }
 
         if (ec) {
@@ -59,25 +698,19 @@ http::message_generator handle_get_request(
         auto const size = body.size();
 
         if (req.method() == http::verb::head) {
-            Log::get().log(Level::INFO, "[handle_get_request] HEAD request for: " + path);
+            Log::get().log(Level::INFO, "[handle_get_request] HEAD request for: " + file.path);
             http::response<http::empty_body> res{http::status::ok, req.version()};
-            res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-            res.set(http::field::content_type, mime_type(path));
-            res.content_length(size);
-            res.keep_alive(req.keep_alive());
+            set_file_headers(res, req, file, size);
             return res;
         }
 
-        Log::get().log(Level::INFO, "[handle_get_request] Serving file: " + path + " with size: " + std::to_string(size));
+        Log::get().log(Level::INFO, "[handle_get_request] Serving file: " + file.path + " with size: " + std::to_string(size));
         http::response<http::file_body> res{
             std::piecewise_construct,
                 std::make_tuple(std::move(body)),
                 std::make_tuple(http::status::ok, req.version())
         };
-        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-        res.set(http::field::content_type, mime_type(path));
-        res.content_length(size);
-        res.keep_alive(req.keep_alive());
+        set_file_headers(res, req, file, size);
         return res;
     } catch (const std::exception& e) {
         Log::get().log(Level::ERROR, "[handle_get_request] Exception caught: " + std::string(e.what()));
@@ -85,6 +718,156 @@ http::message_generator handle_get_request(
     }
 }
 
+// What a route handler is called with
+template <class Body, class Allocator>
+struct route_context
+{
+    beast::string_view doc_root;
+    http::request<Body, http::basic_fields<Allocator>>& req;
+    std::shared_ptr<Application> const& app;
+};
+
+// A cached response for the request, sharing the cached body
+template <class Body, class Allocator>
+http::message_generator replay(
+        http::request<Body, http::basic_fields<Allocator>> const& req,
+        std::shared_ptr<CachedResponse const> const& cached)
+{
+    http::response<shared_body> res{
+        std::piecewise_construct,
+            std::make_tuple(shared_body::value_type{cached->body, cached->body->data(), cached->body->size()}),
+            std::make_tuple(cached->status, req.version())
+    };
+    for (auto const& field : cached->fields) {
+        if (field.name() != http::field::unknown)
+            res.insert(field.name(), field.value());
+        else
+            res.insert(field.name_string(), field.value());
+    }
+    res.set(http::field::date, response_headers::date());
+    res.keep_alive(req.keep_alive());
+    return res;
+}
+
+// Keep a successful response for an Endpoint; see serve_cached. Returns
+// false if it was not kept.
+template <class Endpoint>
+bool store_response(ResponseCache& cache, std::string const& key, http::response<http::string_body> const& res)
+{
+    if (http::to_status_class(res.result()) != http::status_class::successful)
+        return false;
+    auto cached = std::make_shared<CachedResponse>();
+    cached->status = res.result();
+    for (auto const& field : res) {
+        if (field.name() == http::field::date || field.name() == http::field::connection)
+            continue;
+        if (field.name() != http::field::unknown)
+            cached->fields.insert(field.name(), field.value());
+        else
+            cached->fields.insert(field.name_string(), field.value());
+    }
+    cached->body = std::make_shared<std::string const>(res.body());
+    return cache.put(key, std::move(cached), Endpoint::ttl, Endpoint::stale);
+}
+
+// Serve an Endpoint through the ResponseCache. An Endpoint describes a
+// route that opts in:
+//
+//     name    route name, the start of every key and the prefix to purge
+//     ttl     how long a response is fresh
+//     stale   how long after that it is served while being rebuilt
+//     key     what the response varies by, from the request
+//     build   the response, as a string_body
+//
+// A stale hit is answered at once, and its rebuild runs later on the Queue.
+// A rebuild that throws or is not a success leaves the stale response in
+// place, and the next stale hit tries again.
+template <class Endpoint, class Body, class Allocator>
+http::message_generator serve_cached(route_context<Body, Allocator>& ctx)
+{
+    auto const cache = ctx.app->get_response_cache();
+    std::string key = std::string(Endpoint::name) + '\n' + Endpoint::key(ctx.req);
+    auto const found = cache->get(key);
+    if (!found.response) {
+        auto res = Endpoint::build(ctx);
+        store_response<Endpoint>(*cache, key, res);
+        return res;
+    }
+
+    if (found.refresh) {
+        Log::get().log(Level::INFO, "[serve_cached] Refreshing stale response for: " + std::string(Endpoint::name));
+        ctx.app->get_queue()->defer(
+            [doc_root = ctx.doc_root, req = ctx.req, app = ctx.app, key = std::move(key)]() mutable {
+                auto const cache = app->get_response_cache();
+                try {
+                    route_context<Body, Allocator> refresh{doc_root, req, app};
+                    auto res = Endpoint::build(refresh);
+                    if (store_response<Endpoint>(*cache, key, res))
+                        return;
+                    Log::get().log(Level::WARN, "[serve_cached] Refresh not kept (" + std::to_string(res.result_int()) + ") for: " + std::string(Endpoint::name));
+                } catch (const std::exception& e) {
+                    Log::get().log(Level::ERROR, "[serve_cached] Refresh failed: " + std::string(e.what()));
+                }
+                cache->refresh_failed(key);
+            });
+    }
+    return replay(ctx.req, found.response);
+}
+
+// POST / answers with the same document every time
+struct post_root
+{
+    static constexpr char const* name = "POST /";
+    static constexpr std::chrono::seconds ttl{60};
+    static constexpr std::chrono::seconds stale{300};
+
+    // send_ compresses for clients that accept gzip
+    template <class Request>
+    static std::string key(Request const& req)
+    {
+        return (accepted_encodings(req[http::field::accept_encoding]) & FileCache::gzip) ? "gzip" : "identity";
+    }
+
+    template <class Body, class Allocator>
+    static http::response<http::string_body> build(route_context<Body, Allocator>& ctx)
+    {
+        return handle_post_request(ctx.req);
+    }
+};
+
+template <class Body, class Allocator>
+http::message_generator get_static(route_context<Body, Allocator>& ctx, beast::string_view)
+{
+    return handle_get_request(ctx.doc_root, std::move(ctx.req), ctx.app);
+}
+
+// The routes served by handle_request; see route_table.hpp
+template <class Body, class Allocator>
+constexpr auto route_table = std::make_tuple(
+    route(http::verb::post, "/", &serve_cached<post_root, Body, Allocator>),
+    route(http::verb::get, "/*path", &get_static<Body, Allocator>),
+    route(http::verb::head, "/*path", &get_static<Body, Allocator>));
+
+template <class Body, class Allocator>
+boost::optional<http::message_generator> intercept_request(
+        http::request<Body, http::basic_fields<Allocator>>& req)
+{
+    auto res = middleware.on_request(req);
+    if (!res)
+        return boost::none;
+    Log::get().log(Level::INFO, "[intercept_request] Answered by middleware: " + std::string(req.method_string()) + " " + std::string(req.target()));
+    res->prepare_payload();
+    return http::message_generator(std::move(*res));
+}
+
+template <class Body, class Allocator>
+void decorate_response(
+        http::response_header<>& res,
+        http::request<Body, http::basic_fields<Allocator>> const& req)
+{
+    decorate(res, req);
+}
+
 template <class Body, class Allocator>
 http::message_generator handle_request(
         beast::string_view doc_root,
@@ -98,51 +881,186 @@ http::message_generator handle_request(
 
     app->get_queue()->enqueue([doc_root, req = std::move(req), app, response_promise]() mutable {
         Log::get().log(Level::INFO, "[handle_request] Handling request for target: " + std::string(req.target()));
-        if (req.method() == http::verb::post && req.target() == "/") {
-            response_promise->set_value(handle_post_request(std::move(req), app));
-        } else if (req.method() == http::verb::get || req.method() == http::verb::head) {
-            response_promise->set_value(handle_get_request(doc_root, std::move(req), app));
+        static auto const routes = make_router<route_table<Body, Allocator>>();
+        auto const target = req.target();
+        route_params params;
+        auto const found = routes.match(req.method(), target.substr(0, target.find('?')), params);
+        route_context<Body, Allocator> ctx{doc_root, req, app};
+        boost::optional<http::message_generator> response;
+        if (found.handler && (response = (*found.handler)(ctx, params))) {
+            response_promise->set_value(std::move(*response));
+        } else if (!found.allowed.empty() && !found.handler) {
+            auto res = send_(req, http::status::method_not_allowed, "Unknown HTTP-method");
+            res.set(http::field::allow, found.allow());
+            response_promise->set_value(std::move(res));
         } else {
-            response_promise->set_value(send_(req, http::status::bad_request, "Unknown HTTP-method"));
+            response_promise->set_value(send_(req, http::status::not_found, R"({"error": "Not found"})"));
         }
     });
 
     return response_future.get();
 }
 
+template <class Body, class Allocator>
+boost::optional<sendfile_response> prepare_sendfile(
+        beast::string_view doc_root,
+        http::request<Body, http::basic_fields<Allocator>> const& req,
+        std::shared_ptr<Application> app)
+{
+    if (req.method() != http::verb::get || !req[http::field::range].empty())
+        return boost::none;
+
+    try {
+        auto const logical = unfingerprint(*app->get_fingerprints(), req.target());
+        beast::string_view const target = logical ? beast::string_view(*logical) : req.target();
+
+        // Bundled assets are already in memory
+        if (auto bundle = app->get_bundle()) {
+            if (find_asset(*bundle, target))
+                return boost::none;
+        }
+
+        std::string const path = resolve_path(doc_root, target);
+        if (app->get_negative_cache()->contains(path))
+            return boost::none;
+
+        auto const cache = app->get_file_cache();
+        unsigned const accepted = accepted_encodings(req[http::field::accept_encoding]);
+        static_file file = resolve_static_file(path, *cache, accepted);
+        if (logical)
+            file.cache_control = immutable_cache_control;
+
+        // Files small enough to cache are already served from memory
+        auto const open = app->get_fd_cache()->get(file.path);
+        if (!open || static_cast<std::uint64_t>(open->st.st_size) <= cache->max_file_size())
+            return boost::none;
+        struct stat const& st = open->st;
+
+        file.validators(st.st_ino, st.st_size,
+            static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec);
+        if (not_modified(req, file.etag, st.st_mtim.tv_sec))
+            return boost::none;
+
+        // Splice the per-thread status, Server and Content-Type block ahead
+        // of the fields that vary by file. A header rule may have replaced
+        // Server, in which case the response's own fields are written.
+        http::response<http::empty_body> res{http::status::ok, req.version()};
+        set_file_headers(res, req, file, st.st_size);
+        std::string header;
+        header.reserve(512);
+        auto const content_type = res[http::field::content_type];
+        bool const preserialized =
+            res[http::field::server] == BOOST_BEAST_VERSION_STRING && !content_type.empty();
+        if (preserialized) {
+            auto const block = response_headers::block(req.version(), http::status::ok, content_type);
+            header.append(block.data(), block.size());
+        } else {
+            header.append(req.version() == 10 ? "HTTP/1.0 200 OK\r\n" : "HTTP/1.1 200 OK\r\n");
+        }
+        for (auto const& field : res.base()) {
+            if (preserialized && (field.name() == http::field::server || field.name() == http::field::content_type))
+                continue;
+            auto const name = field.name_string();
+            auto const value = field.value();
+            header.append(name.data(), name.size()).append(": ").append(value.data(), value.size()).append("\r\n");
+        }
+        header.append("\r\n");
+
+        Log::get().log(Level::INFO, "[prepare_sendfile] Sending file: " + file.path + " with size: " + std::to_string(st.st_size));
+        return sendfile_response{
+            std::move(header),
+            open->file,
+            0,
+            static_cast<std::uint64_t>(st.st_size),
+            res.keep_alive()};
+    } catch (const std::exception& e) {
+        Log::get().log(Level::ERROR, "[prepare_sendfile] Exception caught: " + std::string(e.what()));
+        return boost::none;
+    }
+}
+
+// Types loaded from a mime.types file at startup, laid over the built-in
+// table so a deployment can override or extend it. Only written before
+// the server starts, so lookups need no lock.
+static mime_table::overlay mime_types;
+
+void load_mime_types(std::string const& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+        throw std::runtime_error("Could not open file: " + path);
+
+    // Lines are "type ext1 ext2 ..."; '#' starts a comment
+    std::string line;
+    std::size_t count = 0;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string type, ext;
+        if (!(fields >> type))
+            continue;
+        while (fields >> ext) {
+            mime_types.add(ext, type);
+            ++count;
+        }
+    }
+    Log::get().log(Level::INFO, "[load_mime_types] Loaded " + std::to_string(count) + " extension(s) from " + path);
+}
+
+void load_header_rules(std::string const& path)
+{
+    header_rules = header_policy::load(path);
+}
 
 beast::string_view mime_type(beast::string_view path)
 {
-    using beast::iequals;
-    auto const ext = [&path]
-    {
-        auto const pos = path.rfind(".");
-        if(pos == beast::string_view::npos)
-            return beast::string_view{};
-        return path.substr(pos);
-    }();
-    if(iequals(ext, ".htm"))  return "text/html";
-    if(iequals(ext, ".html")) return "text/html";
-    if(iequals(ext, ".php"))  return "text/html";
-    if(iequals(ext, ".css"))  return "text/css";
-    if(iequals(ext, ".txt"))  return "text/plain";
-    if(iequals(ext, ".js"))   return "application/javascript";
-    if(iequals(ext, ".json")) return "application/json";
-    if(iequals(ext, ".xml"))  return "application/xml";
-    if(iequals(ext, ".swf"))  return "application/x-shockwave-flash";
-    if(iequals(ext, ".flv"))  return "video/x-flv";
-    if(iequals(ext, ".png"))  return "image/png";
-    if(iequals(ext, ".jpe"))  return "image/jpeg";
-    if(iequals(ext, ".jpeg")) return "image/jpeg";
-    if(iequals(ext, ".jpg"))  return "image/jpeg";
-    if(iequals(ext, ".gif"))  return "image/gif";
-    if(iequals(ext, ".bmp"))  return "image/bmp";
-    if(iequals(ext, ".ico"))  return "image/vnd.microsoft.icon";
-    if(iequals(ext, ".tiff")) return "image/tiff";
-    if(iequals(ext, ".tif"))  return "image/tiff";
-    if(iequals(ext, ".svg"))  return "image/svg+xml";
-    if(iequals(ext, ".svgz")) return "image/svg+xml";
-    return "application/text";
+    auto const pos = path.rfind(".");
+    if (pos == beast::string_view::npos)
+        return "application/text";
+    std::string_view const ext(path.data() + pos + 1, path.size() - pos - 1);
+    auto const type = mime_types.lookup(ext);
+    if (type.empty())
+        return "application/text";
+    return beast::string_view(type.data(), type.size());
+}
+
+unsigned accepted_encodings(beast::string_view accept_encoding)
+{
+    unsigned accepted = 0;
+    while (!accept_encoding.empty()) {
+        auto const comma = accept_encoding.find(',');
+        auto item = accept_encoding.substr(0, comma);
+        accept_encoding = comma == beast::string_view::npos
+            ? beast::string_view{} : accept_encoding.substr(comma + 1);
+
+        // "name" or "name;q=value", where q=0 means not acceptable
+        auto const semi = item.find(';');
+        auto name = item.substr(0, semi);
+        bool acceptable = true;
+        if (semi != beast::string_view::npos) {
+            auto params = item.substr(semi + 1);
+            auto const q = params.find("q=");
+            if (q != beast::string_view::npos) {
+                auto value = params.substr(q + 2);
+                auto const digit = value.find_first_of("123456789");
+                acceptable = digit != beast::string_view::npos && digit < value.find_first_of(",;");
+            }
+        }
+        while (!name.empty() && (name.front() == ' ' || name.front() == '\t'))
+            name.remove_prefix(1);
+        while (!name.empty() && (name.back() == ' ' || name.back() == '\t'))
+            name.remove_suffix(1);
+        if (!acceptable)
+            continue;
+
+        if (beast::iequals(name, "gzip") || beast::iequals(name, "x-gzip"))
+            accepted |= FileCache::gzip;
+        else if (beast::iequals(name, "br"))
+            accepted |= FileCache::brotli;
+        else if (name == "*")
+            accepted |= FileCache::gzip | FileCache::brotli;
+    }
+    return accepted;
 }
 
 std::string path_cat(beast::string_view base, beast::string_view path)
@@ -168,8 +1086,20 @@ std::string path_cat(beast::string_view base, beast::string_view path)
 }
 
 
+template boost::optional<http::message_generator> intercept_request<http::string_body, std::allocator<char>>(
+    http::request<http::string_body, http::basic_fields<std::allocator<char>>>&);
+
+template void decorate_response<http::string_body, std::allocator<char>>(
+    http::response_header<>&,
+    http::request<http::string_body, http::basic_fields<std::allocator<char>>> const&);
+
 template http::message_generator handle_request<http::string_body, std::allocator<char>>(
         beast::string_view doc_root,
         http::request<http::string_body, http::basic_fields<std::allocator<char>>>&& req,
         std::shared_ptr<Application> app);
 
+template boost::optional<sendfile_response> prepare_sendfile<http::string_body, std::allocator<char>>(
+        beast::string_view doc_root,
+        http::request<http::string_body, http::basic_fields<std::allocator<char>>> const& req,
+        std::shared_ptr<Application> app);
+
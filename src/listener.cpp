@@ -1,17 +1,18 @@
 #include "../include/http_tools.hpp"
 #include "../include/listener.hpp"
 #include "../include/session.hpp"
+#include "../include/plain_session.hpp"
 #include "../include/utils.hpp"
 
 listener::listener(
     net::io_context& ioc,
-    ssl::context& ctx,
+    std::shared_ptr<context_holder> ctx,
     tcp::endpoint endpoint,
     std::shared_ptr<std::string const> const& doc_root,
     std::shared_ptr<Application> app)
     : ioc_(ioc)
     , ctx_(ctx)
-    , acceptor_(ioc)
+    , acceptor_(net::make_strand(ioc))
     , doc_root_(doc_root)
     , app_(app)
 {
@@ -45,6 +46,41 @@ listener::listener(
         fail(ec, "listen");
         return;
     }
+    listening_ = true;
+}
+
+listener::listener(
+    net::io_context& ioc,
+    std::shared_ptr<context_holder> ctx,
+    tcp::endpoint endpoint,
+    tcp::acceptor::native_handle_type handle,
+    std::shared_ptr<std::string const> const& doc_root,
+    std::shared_ptr<Application> app)
+    : ioc_(ioc)
+    , ctx_(ctx)
+    , acceptor_(net::make_strand(ioc))
+    , doc_root_(doc_root)
+    , app_(app)
+{
+    beast::error_code ec;
+
+    acceptor_.assign(endpoint.protocol(), handle, ec);
+    if(ec)
+    {
+        fail(ec, "assign");
+        return;
+    }
+    listening_ = true;
+}
+
+bool listener::listening() const
+{
+    return listening_;
+}
+
+tcp::acceptor::native_handle_type listener::native_handle()
+{
+    return acceptor_.native_handle();
 }
 
 void listener::run()
@@ -52,6 +88,17 @@ void listener::run()
     do_accept();
 }
 
+void listener::stop()
+{
+    net::post(
+        acceptor_.get_executor(),
+        [self = shared_from_this()]
+        {
+            beast::error_code ec;
+            self->acceptor_.close(ec);
+        });
+}
+
 void listener::do_accept()
 {
     acceptor_.async_accept(
@@ -63,16 +110,26 @@ void listener::do_accept()
 
 void listener::on_accept(beast::error_code ec, tcp::socket socket)
 {
+    if(ec == net::error::operation_aborted)
+        return;
+
     if(ec)
     {
         fail(ec, "accept");
         return;
     }
+    else if(! ctx_)
+    {
+        std::make_shared<plain_session>(
+            std::move(socket),
+            doc_root_,
+            app_)->run();
+    }
     else
     {
         std::make_shared<session>(
             std::move(socket),
-            ctx_,
+            ctx_->get(),
             doc_root_,
             app_)->run();
     }
@@ -0,0 +1,195 @@
+#include "../include/mapped_file.hpp"
+#include "../include/services/log.hpp"
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+std::int64_t mtime_of(struct stat const& st)
+{
+    return static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+// Live mappings by path; entries expire with the last response using them
+std::mutex registry_mutex;
+std::unordered_map<std::string, std::weak_ptr<mapped_file const>> registry;
+
+// Address ranges of live mappings, read by the SIGBUS handler, which can
+// take no locks. A file truncated under a mapping makes reads past its
+// new end raise SIGBUS; the handler maps zero pages over the lost tail and
+// flags the slot, so the reader sees zeros instead of the server dying.
+// A file that finds no free slot is not mapped.
+constexpr std::size_t max_slots = 1024;
+
+struct slot
+{
+    std::atomic<std::uintptr_t> begin{0};
+    std::atomic<std::uintptr_t> end{0};
+    std::atomic<bool> torn{false};
+};
+
+slot slots[max_slots];
+std::uintptr_t page_size = 4096;
+struct sigaction previous_bus;
+std::once_flag guard_installed;
+
+void on_bus(int sig, siginfo_t* info, void* context)
+{
+    auto const addr = reinterpret_cast<std::uintptr_t>(info->si_addr);
+    for(auto& s : slots)
+    {
+        auto const begin = s.begin.load();
+        auto const end = s.end.load();
+        if(begin == 0 || addr < begin || addr >= end)
+            continue;
+        auto const page = addr & ~(page_size - 1);
+        if(::mmap(reinterpret_cast<void*>(page), end - page, PROT_READ,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED)
+            break;
+        s.torn = true;
+        return; // the faulting read is retried and sees zeros
+    }
+
+    // Not ours: let the previous disposition have it
+    if(previous_bus.sa_flags & SA_SIGINFO)
+        return previous_bus.sa_sigaction(sig, info, context);
+    if(previous_bus.sa_handler != SIG_DFL && previous_bus.sa_handler != SIG_IGN)
+        return previous_bus.sa_handler(sig);
+    ::signal(SIGBUS, SIG_DFL); // the fault repeats and terminates as usual
+}
+
+void install_guard()
+{
+    page_size = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+    struct sigaction sa{};
+    sa.sa_sigaction = on_bus;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    ::sigaction(SIGBUS, &sa, &previous_bus);
+}
+
+// Claim a slot for a mapping, or return max_slots if all are taken
+std::size_t claim_slot(void const* data, std::size_t size)
+{
+    auto const begin = reinterpret_cast<std::uintptr_t>(data);
+    for(std::size_t i = 0; i < max_slots; ++i)
+    {
+        std::uintptr_t expected = 0;
+        if(slots[i].begin.compare_exchange_strong(expected, begin))
+        {
+            slots[i].torn = false;
+            slots[i].end = begin + size;
+            return i;
+        }
+    }
+    return max_slots;
+}
+
+} // namespace
+
+std::shared_ptr<mapped_file const> mapped_file::open(std::string const& path, struct stat const& st, int fd)
+{
+    if(! S_ISREG(st.st_mode))
+        return nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto it = registry.find(path);
+        if(it != registry.end())
+        {
+            auto existing = it->second.lock();
+            if(existing && ! existing->torn() &&
+               existing->size_ == static_cast<std::size_t>(st.st_size) &&
+               existing->inode_ == static_cast<std::uint64_t>(st.st_ino) &&
+               existing->mtime_ == mtime_of(st))
+                return existing;
+            if(! existing)
+                registry.erase(it);
+        }
+    }
+
+    // An empty file cannot be mapped, but needs no bytes either
+    if(st.st_size == 0)
+        return std::make_shared<mapped_file const>(nullptr, 0, st.st_ino, mtime_of(st), max_slots);
+
+    std::call_once(guard_installed, install_guard);
+
+    bool const owned = fd < 0;
+    if(owned)
+    {
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+            return nullptr;
+
+        // The file may have been replaced since st was taken
+        struct stat now;
+        if(::fstat(fd, &now) != 0 || now.st_ino != st.st_ino || now.st_size != st.st_size)
+        {
+            ::close(fd);
+            return nullptr;
+        }
+    }
+
+    void* addr = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if(owned)
+        ::close(fd);
+    if(addr == MAP_FAILED)
+    {
+        Log::get().log(Level::WARN, "[mapped_file] mmap failed for: " + path);
+        return nullptr;
+    }
+
+    auto const slot = claim_slot(addr, static_cast<std::size_t>(st.st_size));
+    if(slot == max_slots)
+    {
+        ::munmap(addr, static_cast<std::size_t>(st.st_size));
+        Log::get().log(Level::WARN, "[mapped_file] Too many live mappings, not mapping: " + path);
+        return nullptr;
+    }
+
+    // Most responses stream the whole file front to back
+    ::madvise(addr, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+
+    auto mapped = std::make_shared<mapped_file const>(
+        static_cast<char const*>(addr), static_cast<std::size_t>(st.st_size), st.st_ino, mtime_of(st), slot);
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry[path] = mapped;
+    return mapped;
+}
+
+mapped_file::mapped_file(char const* data, std::size_t size, std::uint64_t inode, std::int64_t mtime, std::size_t slot)
+    : data_(data)
+    , size_(size)
+    , inode_(inode)
+    , mtime_(mtime)
+    , slot_(slot)
+{
+}
+
+mapped_file::~mapped_file()
+{
+    if(! data_)
+        return;
+    if(torn())
+        Log::get().log(Level::WARN, "[mapped_file] A mapped file was truncated while being served; replace files by rename");
+    // Release the slot first: once unmapped, the range may be reused by
+    // another mapping and the handler must not cover it with zero pages
+    if(slot_ < max_slots)
+    {
+        slots[slot_].end = 0;
+        slots[slot_].begin = 0;
+    }
+    ::munmap(const_cast<char*>(data_), size_);
+}
+
+bool mapped_file::torn() const
+{
+    return slot_ < max_slots && slots[slot_].torn.load();
+}
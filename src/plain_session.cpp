@@ -0,0 +1,191 @@
+#include "../include/plain_session.hpp"
+#include "../include/http_tools.hpp"
+#include "../include/utils.hpp"
+#include <sys/sendfile.h>
+
+plain_session::plain_session(
+    tcp::socket&& socket,
+    std::shared_ptr<std::string const> const& doc_root,
+    std::shared_ptr<Application> app)
+
+    : stream_(std::move(socket))
+    , send_timer_(stream_.get_executor())
+    , doc_root_(doc_root)
+    , app_(app)
+{
+}
+
+void plain_session::run()
+{
+    net::dispatch(
+        stream_.get_executor(),
+        beast::bind_front_handler(
+            &plain_session::do_read,
+            shared_from_this()));
+}
+
+void plain_session::do_read()
+{
+    req_ = {};
+
+    stream_.expires_after(std::chrono::seconds(30));
+
+    http::async_read(stream_, buffer_, req_,
+        beast::bind_front_handler(
+            &plain_session::on_read,
+            shared_from_this()));
+}
+
+void plain_session::on_read(beast::error_code ec, std::size_t bytes_transferred)
+{
+    boost::ignore_unused(bytes_transferred);
+
+    if(ec == http::error::end_of_stream)
+        return do_close();
+
+    if(ec)
+        return fail(ec, "read");
+
+    // While draining, tell keep-alive clients to reconnect elsewhere
+    if(app_->draining())
+        req_.keep_alive(false);
+
+    app_->request_started();
+
+    if(auto res = intercept_request(req_))
+        return send_response(std::move(*res));
+
+    if(auto file = prepare_sendfile(*doc_root_, req_, app_))
+    {
+        file_ = std::move(*file);
+        stream_.expires_after(std::chrono::seconds(30));
+        return net::async_write(
+            stream_,
+            net::buffer(file_.header),
+            beast::bind_front_handler(
+                &plain_session::on_header,
+                shared_from_this()));
+    }
+
+    send_response(
+        handle_request(*doc_root_, std::move(req_), app_));
+}
+
+void plain_session::send_response(http::message_generator&& msg)
+{
+    bool keep_alive = msg.keep_alive();
+
+    beast::async_write(
+        stream_,
+        std::move(msg),
+        beast::bind_front_handler(
+            &plain_session::on_write, this->shared_from_this(), keep_alive));
+}
+
+void plain_session::on_write(bool keep_alive, beast::error_code ec, std::size_t bytes_transferred)
+{
+    boost::ignore_unused(bytes_transferred);
+
+    app_->request_finished();
+
+    if(ec)
+        return fail(ec, "write");
+
+    if(! keep_alive)
+    {
+        return do_close();
+    }
+
+    do_read();
+}
+
+void plain_session::on_header(beast::error_code ec, std::size_t bytes_transferred)
+{
+    boost::ignore_unused(bytes_transferred);
+
+    if(ec)
+    {
+        file_ = {};
+        return on_write(false, ec, 0);
+    }
+
+    stream_.socket().native_non_blocking(true, ec);
+    if(ec)
+    {
+        file_ = {};
+        return on_write(false, ec, 0);
+    }
+
+    do_sendfile();
+}
+
+void plain_session::do_sendfile()
+{
+    beast::error_code ec;
+    while(file_.length > 0)
+    {
+        off_t offset = static_cast<off_t>(file_.offset);
+        auto const n = ::sendfile(
+            stream_.socket().native_handle(),
+            file_.file->fd(),
+            &offset,
+            static_cast<std::size_t>(std::min<std::uint64_t>(file_.length, 1 << 30)));
+
+        if(n > 0)
+        {
+            file_.offset += static_cast<std::uint64_t>(n);
+            file_.length -= static_cast<std::uint64_t>(n);
+            continue;
+        }
+
+        if(n < 0 && errno == EINTR)
+            continue;
+
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            // Socket buffer full: let the reactor tell us when to resume.
+            // A raw wait has no timeout of its own, so a client that stops
+            // reading is cut off by the timer instead
+            send_timer_.expires_after(std::chrono::seconds(30));
+            send_timer_.async_wait(
+                [self = shared_from_this()](beast::error_code ec)
+                {
+                    // A timer re-armed for a later wait is not expired yet
+                    if(! ec && self->send_timer_.expiry() <= net::steady_timer::clock_type::now())
+                        self->stream_.socket().cancel(ec);
+                });
+            stream_.socket().async_wait(
+                tcp::socket::wait_write,
+                [self = shared_from_this()](beast::error_code ec)
+                {
+                    bool const expired = self->send_timer_.expiry() <= net::steady_timer::clock_type::now();
+                    self->send_timer_.cancel();
+                    if(ec == net::error::operation_aborted && expired)
+                        ec = beast::error::timeout;
+                    if(ec)
+                    {
+                        self->file_ = {};
+                        return self->on_write(false, ec, 0);
+                    }
+                    self->do_sendfile();
+                });
+            return;
+        }
+
+        // The file shrank underneath us, or the socket failed
+        ec = n < 0
+            ? beast::error_code(errno, beast::system_category())
+            : beast::error_code(http::error::short_read);
+        break;
+    }
+
+    bool const keep_alive = file_.keep_alive;
+    file_ = {};
+    on_write(keep_alive && ! ec, ec, 0);
+}
+
+void plain_session::do_close()
+{
+    beast::error_code ec;
+    stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+}
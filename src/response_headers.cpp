@@ -0,0 +1,87 @@
+#include "../include/response_headers.hpp"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+namespace response_headers {
+
+namespace {
+
+// The date last formatted by tick(), published by bumping generation
+std::mutex date_mutex;
+std::string current_date;
+std::atomic<std::uint64_t> generation{0};
+
+struct thread_cache
+{
+    std::uint64_t generation = 0;
+    std::string date;
+    std::string key;
+    std::unordered_map<std::string, std::string> blocks;
+};
+
+thread_local thread_cache local;
+
+// Content types come from the MIME tables, so this is only reached by
+// responses built with unusual types
+constexpr std::size_t max_blocks = 256;
+
+} // namespace
+
+std::string http_date(std::time_t t)
+{
+    std::tm tm;
+    gmtime_r(&t, &tm);
+    char buf[32];
+    auto const n = std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return std::string(buf, n);
+}
+
+void tick()
+{
+    auto date = http_date(std::time(nullptr));
+    std::lock_guard<std::mutex> lock(date_mutex);
+    if (date == current_date)
+        return;
+    current_date = std::move(date);
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+beast::string_view date()
+{
+    auto g = generation.load(std::memory_order_acquire);
+    if (g == 0) {
+        tick();
+        g = generation.load(std::memory_order_acquire);
+    }
+    if (local.generation != g) {
+        std::lock_guard<std::mutex> lock(date_mutex);
+        local.date = current_date;
+        local.generation = generation.load(std::memory_order_relaxed);
+    }
+    return local.date;
+}
+
+beast::string_view block(unsigned version, http::status status, beast::string_view content_type)
+{
+    auto& key = local.key;
+    key.assign(std::to_string(version * 1000 + static_cast<unsigned>(status)));
+    key.append(content_type.data(), content_type.size());
+    auto it = local.blocks.find(key);
+    if (it != local.blocks.end())
+        return it->second;
+
+    if (local.blocks.size() >= max_blocks)
+        local.blocks.clear();
+
+    std::string serialized = version == 10 ? "HTTP/1.0 " : "HTTP/1.1 ";
+    serialized.append(std::to_string(static_cast<unsigned>(status))).append(" ");
+    auto const reason = http::obsolete_reason(status);
+    serialized.append(reason.data(), reason.size()).append("\r\n");
+    serialized.append("Server: " BOOST_BEAST_VERSION_STRING "\r\n");
+    serialized.append("Content-Type: ").append(content_type.data(), content_type.size()).append("\r\n");
+    return local.blocks.emplace(key, std::move(serialized)).first->second;
+}
+
+} // namespace response_headers
@@ -0,0 +1,111 @@
+#include "../../include/services/broadcast.hpp"
+#include "../../include/services/log.hpp"
+
+// Constructor implementation
+Broadcast::Broadcast(std::size_t max_pending)
+    : max_pending_(max_pending) {
+}
+
+void Broadcast::add_channel(const std::string& path) {
+    std::lock_guard<std::mutex> lock(channels_mutex_);
+    channels_[path];
+    Log::get().log(Level::INFO, "[Broadcast] Channel registered: " + path);
+}
+
+bool Broadcast::has_channel(beast::string_view target) const {
+    std::lock_guard<std::mutex> lock(channels_mutex_);
+    return channels_.find(std::string(channel_of(target))) != channels_.end();
+}
+
+void Broadcast::subscribe(beast::string_view target, std::weak_ptr<Subscriber> subscriber) {
+    std::lock_guard<std::mutex> lock(channels_mutex_);
+    auto it = channels_.find(std::string(channel_of(target)));
+    if (it == channels_.end())
+        return;
+    it->second.push_back(std::move(subscriber));
+    Log::get().log(Level::INFO, "[Broadcast] Subscriber added to " + it->first +
+                                  ". Subscribers: " + std::to_string(it->second.size()));
+}
+
+std::size_t Broadcast::publish(const std::string& path, const std::string& event, const std::string& data) {
+    auto const buffer = encode(event, data);
+    std::vector<std::shared_ptr<Subscriber>> dropped;
+    std::size_t delivered = 0;
+    {
+        std::lock_guard<std::mutex> lock(channels_mutex_);
+        auto it = channels_.find(path);
+        if (it == channels_.end())
+            return 0;
+
+        // Deliver and compact in one pass, removing closed and slow subscribers
+        auto& subscribers = it->second;
+        std::size_t kept = 0;
+        for (auto& weak : subscribers) {
+            auto subscriber = weak.lock();
+            if (!subscriber)
+                continue;
+            if (!subscriber->deliver(buffer)) {
+                dropped.push_back(std::move(subscriber));
+                continue;
+            }
+            ++delivered;
+            subscribers[kept++] = std::move(weak);
+        }
+        subscribers.resize(kept);
+    }
+
+    for (auto& subscriber : dropped)
+        subscriber->close();
+    if (!dropped.empty())
+        Log::get().log(Level::WARN, "[Broadcast] Dropped " + std::to_string(dropped.size()) +
+                                      " slow subscriber(s) from " + path);
+    return delivered;
+}
+
+void Broadcast::close_all() {
+    std::vector<std::shared_ptr<Subscriber>> subscribers;
+    {
+        std::lock_guard<std::mutex> lock(channels_mutex_);
+        for (auto& [path, list] : channels_) {
+            for (auto& weak : list)
+                if (auto subscriber = weak.lock())
+                    subscribers.push_back(std::move(subscriber));
+            list.clear();
+        }
+    }
+    for (auto& subscriber : subscribers)
+        subscriber->close();
+}
+
+std::size_t Broadcast::max_pending() const { return max_pending_; }
+
+Broadcast::Buffer Broadcast::encode(const std::string& event, const std::string& data) {
+    std::string out;
+    out.reserve(event.size() + data.size() + 16);
+    if (!event.empty()) {
+        // A line break would end the field and let the rest of the name
+        // pose as fields of its own, so the name is kept to one line
+        out.append("event: ");
+        for (char c : event)
+            if (c != '\r' && c != '\n')
+                out.push_back(c);
+        out.append("\n");
+    }
+    // Each line of the payload becomes its own data field; CR, LF and
+    // CRLF all end a line in an event stream
+    std::size_t start = 0;
+    for (;;) {
+        auto const end = data.find_first_of("\r\n", start);
+        out.append("data: ").append(data, start, end == std::string::npos ? std::string::npos : end - start).append("\n");
+        if (end == std::string::npos)
+            break;
+        start = end + (data.compare(end, 2, "\r\n") == 0 ? 2 : 1);
+    }
+    out.append("\n");
+    return std::make_shared<std::string const>(std::move(out));
+}
+
+beast::string_view Broadcast::channel_of(beast::string_view target) {
+    auto const pos = target.find('?');
+    return pos == beast::string_view::npos ? target : target.substr(0, pos);
+}
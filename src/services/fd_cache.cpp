@@ -0,0 +1,126 @@
+#include "../../include/services/fd_cache.hpp"
+#include "../../include/services/log.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+bool same_version(struct stat const& a, struct stat const& b) {
+    return a.st_ino == b.st_ino && a.st_dev == b.st_dev && a.st_size == b.st_size &&
+           a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+} // namespace
+
+// Constructor implementation
+FdCache::FdCache(std::size_t max_entries,
+                 std::chrono::milliseconds ttl,
+                 std::shared_ptr<Watcher> watcher)
+    : max_entries_(std::max<std::size_t>(1, max_entries)),
+      ttl_(ttl),
+      watcher_(std::move(watcher)) {
+    Log::get().log(Level::INFO, "[FdCache] Initialized with " + std::to_string(max_entries_) + " entries");
+}
+
+std::shared_ptr<OpenFile const> FdCache::get(const std::string& path) {
+    auto const now = std::chrono::steady_clock::now();
+    std::shared_ptr<OpenFile const> stale;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(path);
+        if (it != entries_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            if (now - it->second.checked < ttl_.load()) {
+                ++hits_;
+                return it->second.file;
+            }
+            stale = it->second.file;
+        }
+    }
+
+    // Past the ttl, keep the descriptor if the path still names the same file
+    if (stale) {
+        struct stat st;
+        if (::stat(path.c_str(), &st) == 0 && same_version(st, stale->st)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(path);
+            if (it != entries_.end() && it->second.file == stale)
+                it->second.checked = now;
+            ++hits_;
+            return stale;
+        }
+    }
+
+    // Concurrent misses share one open
+    bool shared = false;
+    auto file = opens_.run(path, [&] {
+        ++misses_;
+        if (watcher_)
+            watcher_->watch_parent(path);
+        auto file = open(path);
+        if (file) {
+            insert(file, now);
+        } else if (stale) {
+            invalidate(path);
+        }
+        return file;
+    }, &shared);
+    if (shared)
+        ++coalesced_;
+    return file;
+}
+
+void FdCache::invalidate(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (path.empty()) {
+        entries_.clear();
+        lru_.clear();
+        return;
+    }
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+        lru_.erase(it->second.lru);
+        entries_.erase(it);
+    }
+}
+
+void FdCache::set_ttl(std::chrono::milliseconds ttl) {
+    ttl_ = ttl;
+}
+
+FdCache::Stats FdCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Stats{hits_.load(), misses_.load(), coalesced_.load(), entries_.size()};
+}
+
+std::shared_ptr<OpenFile const> FdCache::open(const std::string& path) const {
+    int const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    auto file = std::make_shared<OpenFile>();
+    file->path = path;
+    file->file = std::make_shared<range_body::file_handle const>(fd);
+    if (::fstat(fd, &file->st) != 0 || !S_ISREG(file->st.st_mode))
+        return nullptr;
+    return file;
+}
+
+void FdCache::insert(std::shared_ptr<OpenFile const> file, std::chrono::steady_clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(file->path);
+    if (it != entries_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        it->second.file = std::move(file);
+        it->second.checked = now;
+        return;
+    }
+
+    // Evicted descriptors close once the last response using them finishes
+    while (entries_.size() >= max_entries_) {
+        entries_.erase(lru_.back());
+        lru_.pop_back();
+    }
+    lru_.push_front(file->path);
+    entries_.emplace(lru_.front(), Entry{std::move(file), now, lru_.begin()});
+}
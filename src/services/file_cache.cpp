@@ -0,0 +1,299 @@
+#include "../../include/services/file_cache.hpp"
+#include "../../include/services/log.hpp"
+#include "../../include/compress.hpp"
+#include <algorithm>
+#include <boost/asio/post.hpp>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+std::int64_t mtime_of(struct stat const& st) {
+    return static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+} // namespace
+
+// Constructor implementation
+FileCache::FileCache(std::size_t max_bytes,
+                     std::size_t max_file_size,
+                     std::chrono::milliseconds revalidate,
+                     std::size_t shards)
+    : shard_bytes_(max_bytes / std::max<std::size_t>(1, shards)),
+      max_file_size_(max_file_size),
+      revalidate_(revalidate),
+      workers_(std::max(1u, std::thread::hardware_concurrency() / 4)) {
+    for (std::size_t i = 0; i < std::max<std::size_t>(1, shards); ++i)
+        shards_.push_back(std::make_unique<Shard>());
+    Log::get().log(Level::INFO, "[FileCache] Initialized with " + std::to_string(max_bytes) + " bytes across " +
+                                  std::to_string(shards_.size()) + " shards");
+}
+
+std::shared_ptr<CachedFile const> FileCache::get(const std::string& path) {
+    auto& shard = shard_for(path);
+    auto const now = std::chrono::steady_clock::now();
+    std::shared_ptr<CachedFile const> stale;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto big = shard.oversized.find(path);
+        if (big != shard.oversized.end() && now - big->second < revalidate_.load())
+            return nullptr;
+        auto it = shard.entries.find(path);
+        if (it != shard.entries.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru);
+            if (now - it->second.checked < revalidate_.load()) {
+                ++hits_;
+                return it->second.file;
+            }
+            stale = it->second.file;
+        }
+    }
+
+    // Revalidate outside the lock; an unchanged file just gets a new timestamp
+    if (stale) {
+        struct stat st;
+        if (::stat(path.c_str(), &st) == 0 &&
+            static_cast<std::uint64_t>(st.st_size) == stale->size &&
+            mtime_of(st) == stale->mtime &&
+            static_cast<std::uint64_t>(st.st_ino) == stale->inode) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.entries.find(path);
+            if (it != shard.entries.end() && it->second.file == stale)
+                it->second.checked = now;
+            ++hits_;
+            return stale;
+        }
+    }
+
+    // Concurrent misses share one read
+    bool shared = false;
+    auto file = loads_.run(path, [&] {
+        ++misses_;
+        auto const generation = current_generation(shard);
+        bool too_large = false;
+        auto file = load(path, too_large);
+        if (file)
+            insert(shard, file, generation);
+        else
+            reject(shard, path, too_large, generation);
+        return file;
+    }, &shared);
+    if (shared)
+        ++coalesced_;
+    return file;
+}
+
+unsigned FileCache::precompressed(const std::string& path) {
+    auto& shard = shard_for(path);
+    auto const now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.variants.find(path);
+        if (it != shard.variants.end() && now - it->second.checked < revalidate_.load())
+            return it->second.found;
+    }
+
+    // Only remember paths that exist, so probes for missing files cannot
+    // grow the table
+    auto const generation = current_generation(shard);
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.variants.erase(path);
+        return 0;
+    }
+
+    unsigned found = 0;
+    if (::stat((path + ".gz").c_str(), &st) == 0)
+        found |= gzip;
+    if (::stat((path + ".br").c_str(), &st) == 0)
+        found |= brotli;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.generation == generation)
+        shard.variants[path] = Variants{found, now};
+    return found;
+}
+
+std::shared_ptr<CachedFile const> FileCache::gzipped(std::shared_ptr<CachedFile const> const& source) {
+    auto& shard = shard_for(source->path);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.compressed.find(source->path);
+    if (it != shard.compressed.end() && it->second->mtime == source->mtime)
+        return it->second;
+
+    // One compression per path at a time; a request arriving meanwhile,
+    // even for a newer version, is served uncompressed
+    if (shard.compressing.insert(source->path).second)
+        boost::asio::post(workers_, [this, source] { compress(source); });
+    return nullptr;
+}
+
+void FileCache::compress(std::shared_ptr<CachedFile const> source) {
+    auto body = std::make_shared<std::string const>(gzip_compress(*source->body));
+    auto file = std::make_shared<CachedFile const>(CachedFile{
+        source->path, body->size(), source->mtime, source->inode, body});
+
+    // Only keep it while the source is still the cached version, and only
+    // if it fits beside it
+    auto& shard = shard_for(source->path);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.compressing.erase(source->path);
+    auto it = shard.entries.find(source->path);
+    if (it == shard.entries.end() || it->second.file != source)
+        return;
+    auto& slot = shard.compressed[source->path];
+    if (slot) {
+        shard.bytes -= slot->size;
+        slot.reset();
+    }
+    if (make_room(shard, file->size, &source->path)) {
+        slot = file;
+        shard.bytes += file->size;
+    } else {
+        shard.compressed.erase(source->path);
+    }
+}
+
+void FileCache::invalidate(const std::string& path) {
+    if (path.empty()) {
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            ++shard->generation;
+            shard->variants.clear();
+            shard->oversized.clear();
+            while (!shard->entries.empty())
+                erase(*shard, shard->entries.begin());
+        }
+        return;
+    }
+    auto& shard = shard_for(path);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ++shard.generation;
+    shard.variants.erase(path);
+    shard.oversized.erase(path);
+    auto it = shard.entries.find(path);
+    if (it != shard.entries.end())
+        erase(shard, it);
+}
+
+FileCache::Stats FileCache::stats() const {
+    Stats stats{hits_.load(), misses_.load(), coalesced_.load(), evictions_.load(), 0, 0};
+    for (auto const& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        stats.entries += shard->entries.size();
+        stats.bytes += shard->bytes;
+    }
+    return stats;
+}
+
+void FileCache::set_revalidate(std::chrono::milliseconds revalidate) {
+    revalidate_ = revalidate;
+}
+
+std::size_t FileCache::max_file_size() const {
+    return max_file_size_;
+}
+
+std::uint64_t FileCache::current_generation(Shard& shard) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.generation;
+}
+
+FileCache::Shard& FileCache::shard_for(const std::string& path) {
+    return *shards_[std::hash<std::string>{}(path) % shards_.size()];
+}
+
+std::shared_ptr<CachedFile const> FileCache::load(const std::string& path, bool& too_large) const {
+    int const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return nullptr;
+    }
+    if (static_cast<std::uint64_t>(st.st_size) > max_file_size_) {
+        too_large = true;
+        ::close(fd);
+        return nullptr;
+    }
+
+    std::string body(static_cast<std::size_t>(st.st_size), '\0');
+    std::size_t done = 0;
+    while (done < body.size()) {
+        auto const n = ::read(fd, &body[done], body.size() - done);
+        if (n <= 0)
+            break;
+        done += static_cast<std::size_t>(n);
+    }
+    ::close(fd);
+    if (done != body.size())
+        return nullptr;
+
+    return std::make_shared<CachedFile const>(CachedFile{
+        path,
+        static_cast<std::uint64_t>(st.st_size),
+        mtime_of(st),
+        static_cast<std::uint64_t>(st.st_ino),
+        std::make_shared<std::string const>(std::move(body))});
+}
+
+void FileCache::insert(Shard& shard, std::shared_ptr<CachedFile const> file, std::uint64_t generation) {
+    if (file->size > shard_bytes_)
+        return;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.generation != generation)
+        return;
+    auto it = shard.entries.find(file->path);
+    if (it != shard.entries.end())
+        erase(shard, it);
+
+    make_room(shard, file->size, nullptr);
+    shard.lru.push_front(file->path);
+    shard.bytes += file->size;
+    shard.entries.emplace(file->path, Entry{file, std::chrono::steady_clock::now(), shard.lru.begin()});
+}
+
+void FileCache::reject(Shard& shard, const std::string& path, bool too_large, std::uint64_t generation) {
+    // No generation bump: nothing changed on disk, and concurrent loads of
+    // other files in the shard are still good
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(path);
+    if (it != shard.entries.end())
+        erase(shard, it);
+    if (too_large && shard.generation == generation)
+        shard.oversized[path] = std::chrono::steady_clock::now();
+    else
+        shard.oversized.erase(path);
+}
+
+bool FileCache::make_room(Shard& shard, std::size_t size, const std::string* keep) {
+    while (shard.bytes + size > shard_bytes_ && !shard.lru.empty()) {
+        if (keep && shard.lru.back() == *keep) {
+            // Everything older is gone; evict the newer ones instead
+            if (shard.lru.size() == 1)
+                return false;
+            erase(shard, shard.entries.find(*std::next(shard.lru.rbegin())));
+        } else {
+            erase(shard, shard.entries.find(shard.lru.back()));
+        }
+        ++evictions_;
+    }
+    return shard.bytes + size <= shard_bytes_;
+}
+
+void FileCache::erase(Shard& shard, std::unordered_map<std::string, Entry>::iterator it) {
+    shard.bytes -= it->second.file->size;
+    auto compressed = shard.compressed.find(it->first);
+    if (compressed != shard.compressed.end()) {
+        shard.bytes -= compressed->second->size;
+        shard.compressed.erase(compressed);
+    }
+    shard.lru.erase(it->second.lru);
+    shard.entries.erase(it);
+}
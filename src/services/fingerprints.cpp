@@ -0,0 +1,305 @@
+#include "../../include/services/fingerprints.hpp"
+#include "../../include/services/log.hpp"
+#include "../../include/compress.hpp"
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+// Hex digits of the content hash in a URL; 40 bits is plenty to tell the
+// versions of one file apart
+constexpr std::size_t digits = 10;
+
+std::uint64_t fnv1a(std::uint64_t h, char const* data, std::size_t size) {
+    for (std::size_t i = 0; i < size; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+std::string hex(std::uint64_t h, std::size_t n) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+    return std::string(buf, n);
+}
+
+bool has_extension(std::string_view path, std::string_view ext) {
+    return path.size() > ext.size() && path.substr(path.size() - ext.size()) == ext;
+}
+
+// Pages are entry points whose URLs must stay stable, and precompressed
+// siblings are served in place of their source
+bool fingerprintable(const std::string& path) {
+    if (has_extension(path, ".html") || has_extension(path, ".htm"))
+        return false;
+    if (has_extension(path, ".gz") || has_extension(path, ".br")) {
+        std::error_code ec;
+        return !std::filesystem::is_regular_file(path.substr(0, path.size() - 3), ec);
+    }
+    return true;
+}
+
+// "/app.js" with hash h becomes "/app.<h>.js"
+std::string fingerprint(const std::string& url, const std::string& h) {
+    auto const slash = url.rfind('/');
+    auto const dot = url.rfind('.');
+    if (dot == std::string::npos || dot <= slash + 1)
+        return url + "." + h;
+    return url.substr(0, dot) + "." + h + url.substr(dot);
+}
+
+// Absolute URL path of a reference in a page at page_url, or empty for
+// references to other origins and schemes
+std::string resolve_reference(std::string_view ref, std::string_view page_url) {
+    if (ref.empty() || ref.substr(0, 2) == "//")
+        return {};
+    auto const colon = ref.find(':');
+    if (colon != std::string_view::npos && colon < ref.find('/'))
+        return {};
+    if (ref.front() == '/')
+        return std::string(ref);
+
+    std::string joined(page_url.substr(0, page_url.rfind('/') + 1));
+    joined.append(ref.data(), ref.size());
+
+    // Remove "." and ".." segments
+    std::vector<std::string_view> segments;
+    std::string_view rest(joined);
+    while (!rest.empty()) {
+        auto const slash = rest.find('/', 1);
+        auto const segment = rest.substr(1, slash == std::string_view::npos ? std::string_view::npos : slash - 1);
+        rest = slash == std::string_view::npos ? std::string_view{} : rest.substr(slash);
+        if (segment == "..") {
+            if (!segments.empty())
+                segments.pop_back();
+        } else if (segment != ".") {
+            segments.push_back(segment);
+        }
+    }
+    std::string url;
+    for (auto const& segment : segments)
+        url.append("/").append(segment.data(), segment.size());
+    return url;
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size())
+        return false;
+    for (std::size_t i = 0; i < a.size(); ++i)
+        if (std::tolower(static_cast<unsigned char>(a[i])) != b[i])
+            return false;
+    return true;
+}
+
+} // namespace
+
+std::size_t Fingerprints::build(const std::string& doc_root) {
+    root_ = doc_root;
+    while (root_.size() > 1 && root_.back() == '/')
+        root_.pop_back();
+
+    std::size_t count = 0;
+    std::error_code ec;
+    std::filesystem::recursive_directory_iterator it(
+        root_, std::filesystem::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        auto const path = it->path().string();
+        if (it->is_regular_file(ec) && fingerprintable(path)) {
+            add(path);
+            ++count;
+        }
+    }
+    active_ = true;
+    Log::get().log(Level::INFO, "[Fingerprints] Fingerprinted " + std::to_string(count) + " file(s) under: " + root_);
+    return count;
+}
+
+bool Fingerprints::active() const {
+    return active_;
+}
+
+boost::optional<std::string> Fingerprints::resolve(std::string_view url) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = logical_.find(std::string(url));
+    if (it == logical_.end())
+        return boost::none;
+    return it->second;
+}
+
+std::string Fingerprints::url_for(std::string_view url) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = fingerprinted_.find(std::string(url));
+    return it == fingerprinted_.end() ? std::string(url) : it->second;
+}
+
+std::string Fingerprints::rewrite_html(std::string_view html, std::string_view page_url) const {
+    std::string out;
+    std::size_t copied = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto pos = html.find('='); pos != std::string_view::npos; pos = html.find('=', pos)) {
+        // The attribute name before '=' and the quoted value after it
+        auto name_end = pos;
+        while (name_end > 0 && html[name_end - 1] == ' ')
+            --name_end;
+        auto name_begin = name_end;
+        while (name_begin > 0 && std::isalpha(static_cast<unsigned char>(html[name_begin - 1])))
+            --name_begin;
+        auto value = pos + 1;
+        while (value < html.size() && html[value] == ' ')
+            ++value;
+        pos = value;
+
+        auto const name = html.substr(name_begin, name_end - name_begin);
+        if (value >= html.size() || (html[value] != '"' && html[value] != '\'') ||
+            !(iequals(name, "src") || iequals(name, "href")))
+            continue;
+        auto const end = html.find(html[value], value + 1);
+        if (end == std::string_view::npos)
+            break;
+        pos = end + 1;
+
+        // The query and fragment are kept as they are
+        auto const ref = html.substr(value + 1, end - value - 1);
+        auto const path = ref.substr(0, ref.find_first_of("?#"));
+        auto it = fingerprinted_.find(resolve_reference(path, page_url));
+        if (it == fingerprinted_.end())
+            continue;
+
+        if (out.empty())
+            out.reserve(html.size() + 64);
+        out.append(html.substr(copied, value + 1 - copied));
+        out.append(it->second);
+        out.append(ref.substr(path.size()));
+        copied = end;
+    }
+    if (copied == 0)
+        return std::string(html);
+    out.append(html.substr(copied));
+    return out;
+}
+
+Fingerprints::Page Fingerprints::rewrite(std::shared_ptr<CachedFile const> const& source, std::string_view page_url, bool gzip) {
+    // Relative references resolve against the page's directory, so pages
+    // are remembered per file and directory, not per request URL
+    page_url = page_url.substr(0, page_url.find('?'));
+    std::string key = source->path;
+    key.push_back('\n');
+    key.append(page_url.substr(0, page_url.rfind('/') + 1));
+
+    std::uint64_t version;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        version = version_;
+        auto it = pages_.find(key);
+        if (it != pages_.end() && it->second.source == source && it->second.version == version) {
+            auto const& page = it->second;
+            if (!page.plain.file || !gzip)
+                return page.plain;
+            if (page.gzipped.file)
+                return page.gzipped;
+        }
+    }
+
+    Rewritten page{source, version, {}, {}};
+    std::string body = rewrite_html(*source->body, page_url);
+    if (body != *source->body) {
+        page.plain.tag = hex(fnv1a(14695981039346656037ull, body.data(), body.size()), digits);
+        page.plain.file = std::make_shared<CachedFile const>(CachedFile{
+            source->path, body.size(), source->mtime, source->inode,
+            std::make_shared<std::string const>(std::move(body))});
+        if (gzip) {
+            auto compressed = std::make_shared<std::string const>(gzip_compress(*page.plain.file->body));
+            page.gzipped.tag = page.plain.tag;
+            page.gzipped.file = std::make_shared<CachedFile const>(CachedFile{
+                source->path, compressed->size(), source->mtime, source->inode, compressed});
+        }
+    }
+
+    // Only pages in the FileCache get here, so this is bounded by it in
+    // practice; the clear is a backstop
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (version == version_) {
+        if (pages_.size() >= 4096)
+            pages_.clear();
+        pages_[key] = page;
+    }
+    return gzip && page.plain.file ? page.gzipped : page.plain;
+}
+
+void Fingerprints::update(const std::string& path, bool complete) {
+    if (!active_)
+        return;
+    if (path.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            fingerprinted_.clear();
+            logical_.clear();
+            ++version_;
+        }
+        build(root_);
+        return;
+    }
+
+    auto const url = url_of(path);
+    if (url.empty() || !fingerprintable(path))
+        return;
+
+    // The old URL promised the old bytes forever, so it goes as soon as
+    // the file starts changing; rehash once the file is whole
+    std::error_code ec;
+    if (complete && std::filesystem::is_regular_file(path, ec))
+        add(path);
+    else
+        remove(url);
+}
+
+void Fingerprints::add(const std::string& path) {
+    auto const url = url_of(path);
+    if (url.empty())
+        return;
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return;
+    std::uint64_t h = 14695981039346656037ull;
+    char buffer[64 * 1024];
+    while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0)
+        h = fnv1a(h, buffer, static_cast<std::size_t>(in.gcount()));
+    auto const fingerprinted = fingerprint(url, hex(h, digits));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = fingerprinted_.find(url);
+    if (it != fingerprinted_.end()) {
+        if (it->second == fingerprinted)
+            return;
+        logical_.erase(it->second);
+    }
+    fingerprinted_[url] = fingerprinted;
+    logical_[fingerprinted] = url;
+    ++version_;
+}
+
+void Fingerprints::remove(const std::string& url) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = fingerprinted_.find(url);
+    if (it == fingerprinted_.end())
+        return;
+    logical_.erase(it->second);
+    fingerprinted_.erase(it);
+    ++version_;
+}
+
+// URL path of a file under doc_root, or empty for one outside it
+std::string Fingerprints::url_of(const std::string& path) const {
+    if (path.size() <= root_.size() || path.compare(0, root_.size(), root_) != 0)
+        return {};
+    if (root_ == "/")
+        return path;
+    if (path[root_.size()] != '/')
+        return {};
+    return path.substr(root_.size());
+}
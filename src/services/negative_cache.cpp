@@ -0,0 +1,119 @@
+#include "../../include/services/negative_cache.hpp"
+#include "../../include/services/log.hpp"
+#include <algorithm>
+#include <sys/stat.h>
+
+namespace {
+
+// mtime of a directory, or -1 if it is missing or not a directory
+std::int64_t directory_mtime(const std::string& dir) {
+    struct stat st;
+    if (::stat(dir.empty() ? "/" : dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+        return -1;
+    return static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+} // namespace
+
+// Constructor implementation
+NegativeCache::NegativeCache(std::size_t max_entries, std::chrono::milliseconds revalidate)
+    : max_entries_(std::max<std::size_t>(1, max_entries)),
+      revalidate_(revalidate) {
+    Log::get().log(Level::INFO, "[NegativeCache] Initialized with " + std::to_string(max_entries_) + " entries");
+}
+
+bool NegativeCache::contains(const std::string& path) {
+    auto const now = std::chrono::steady_clock::now();
+    std::string dir;
+    std::int64_t mtime;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(path);
+        if (it == entries_.end())
+            return false;
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        if (now - it->second.checked < revalidate_.load()) {
+            ++hits_;
+            return true;
+        }
+        dir = path.substr(0, it->second.ancestor);
+        mtime = it->second.mtime;
+    }
+
+    // Stat outside the lock; an unchanged directory just gets a new timestamp
+    bool const unchanged = directory_mtime(dir) == mtime;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if (it == entries_.end())
+        return false;
+    if (!unchanged) {
+        lru_.erase(it->second.lru);
+        entries_.erase(it);
+        return false;
+    }
+    it->second.checked = now;
+    ++hits_;
+    return true;
+}
+
+std::uint64_t NegativeCache::generation() const {
+    return generation_.load();
+}
+
+void NegativeCache::insert(const std::string& path, std::uint64_t generation) {
+    // Find the nearest directory above path that exists
+    std::size_t ancestor = path.rfind('/');
+    std::int64_t mtime = -1;
+    while (ancestor != std::string::npos) {
+        mtime = directory_mtime(path.substr(0, ancestor));
+        if (mtime >= 0 || ancestor == 0)
+            break;
+        ancestor = path.rfind('/', ancestor - 1);
+    }
+    if (mtime < 0)
+        return;
+
+    auto const now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (generation_.load() != generation)
+        return;
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        it->second.ancestor = ancestor;
+        it->second.mtime = mtime;
+        it->second.checked = now;
+        return;
+    }
+
+    while (entries_.size() >= max_entries_) {
+        entries_.erase(lru_.back());
+        lru_.pop_back();
+    }
+    lru_.push_front(path);
+    entries_.emplace(lru_.front(), Entry{ancestor, mtime, now, lru_.begin()});
+}
+
+void NegativeCache::invalidate(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    if (path.empty()) {
+        entries_.clear();
+        lru_.clear();
+        return;
+    }
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+        lru_.erase(it->second.lru);
+        entries_.erase(it);
+    }
+}
+
+void NegativeCache::set_revalidate(std::chrono::milliseconds revalidate) {
+    revalidate_ = revalidate;
+}
+
+NegativeCache::Stats NegativeCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Stats{hits_.load(), entries_.size()};
+}
@@ -19,6 +19,7 @@ Queue::~Queue() {
 }
 
 void Queue::enqueue(RequestHandler handler) {
+    pending_.fetch_add(1);
     {
         std::lock_guard<std::mutex> lock{queue_mutex_};
         request_queue_.push(std::move(handler));
@@ -29,11 +30,21 @@ void Queue::enqueue(RequestHandler handler) {
     }
 }
 
+void Queue::defer(RequestHandler handler) {
+    boost::asio::post(ioc_, [this, handler = std::move(handler)]() mutable {
+        enqueue(std::move(handler));
+    });
+}
+
 void Queue::start() {
     Log::get().log(Level::INFO, "[Queue] Starting to process the queue.");
     process_next();
 }
 
+bool Queue::idle() const {
+    return pending_.load() == 0;
+}
+
 void Queue::process_next() {
     std::lock_guard<std::mutex> lock{queue_mutex_};
     if (request_queue_.empty()) {
@@ -46,6 +57,7 @@ void Queue::process_next() {
     Log::get().log(Level::INFO, "[Queue] Processing request. Remaining queue size: " + std::to_string(request_queue_.size()));
 
     handler();
+    pending_.fetch_sub(1);
 
     auto delay = rate_limit_ + throttle_time_;
     if (delay.count() > 0) {
@@ -0,0 +1,98 @@
+#include "../../include/services/response_cache.hpp"
+#include "../../include/services/log.hpp"
+
+// Constructor implementation
+ResponseCache::ResponseCache(std::size_t max_bytes)
+    : max_bytes_(max_bytes) {
+    Log::get().log(Level::INFO, "[ResponseCache] Initialized with " + std::to_string(max_bytes) + " bytes");
+}
+
+ResponseCache::Lookup ResponseCache::get(const std::string& key) {
+    auto const now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        ++misses_;
+        return Lookup{nullptr, false, false};
+    }
+
+    auto& entry = it->second;
+    if (now >= entry.stale_until) {
+        erase(it);
+        ++misses_;
+        return Lookup{nullptr, false, false};
+    }
+
+    lru_.splice(lru_.begin(), lru_, entry.lru);
+    if (now < entry.fresh_until) {
+        ++hits_;
+        return Lookup{entry.response, false, false};
+    }
+
+    ++stale_hits_;
+    bool const refresh = !entry.refreshing;
+    entry.refreshing = true;
+    return Lookup{entry.response, true, refresh};
+}
+
+bool ResponseCache::put(const std::string& key,
+                        std::shared_ptr<CachedResponse const> response,
+                        std::chrono::milliseconds ttl,
+                        std::chrono::milliseconds stale) {
+    std::size_t bytes = key.size() + response->body->size();
+    for (auto const& field : response->fields)
+        bytes += field.name_string().size() + field.value().size();
+    if (bytes > max_bytes_)
+        return false;
+
+    auto const now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end())
+        erase(it);
+
+    // Evict least recently used entries until the new response fits
+    while (bytes_ + bytes > max_bytes_ && !lru_.empty()) {
+        erase(entries_.find(lru_.back()));
+        ++evictions_;
+    }
+
+    lru_.push_front(key);
+    bytes_ += bytes;
+    entries_.emplace(lru_.front(), Entry{std::move(response), bytes, now + ttl, now + ttl + stale, false, lru_.begin()});
+    return true;
+}
+
+void ResponseCache::refresh_failed(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end())
+        it->second.refreshing = false;
+}
+
+std::size_t ResponseCache::purge(const std::string& prefix) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t purged = 0;
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        auto next = std::next(it);
+        if (it->first.compare(0, prefix.size(), prefix) == 0) {
+            erase(it);
+            ++purged;
+        }
+        it = next;
+    }
+    if (purged > 0)
+        Log::get().log(Level::INFO, "[ResponseCache] Purged " + std::to_string(purged) + " entries for: " + prefix);
+    return purged;
+}
+
+ResponseCache::Stats ResponseCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Stats{hits_.load(), stale_hits_.load(), misses_.load(), evictions_.load(), entries_.size(), bytes_};
+}
+
+void ResponseCache::erase(std::unordered_map<std::string, Entry>::iterator it) {
+    bytes_ -= it->second.bytes;
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+}
@@ -0,0 +1,190 @@
+#include "../../include/services/watcher.hpp"
+#include "../../include/services/log.hpp"
+#include <filesystem>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+
+// Any of these on a directory entry may change what a cache holds for it
+constexpr std::uint32_t watch_mask =
+    IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+    IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+// Paths are compared as strings, so "www/" and "www" must be the same key
+std::string normalize(std::string dir) {
+    while (dir.size() > 1 && dir.back() == '/')
+        dir.pop_back();
+    return dir;
+}
+
+} // namespace
+
+// Constructor implementation
+Watcher::Watcher()
+    : fd_(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+      wake_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    if (fd_ < 0 || wake_ < 0) {
+        Log::get().log(Level::WARN, "[Watcher] inotify unavailable, file changes will not be pushed");
+        return;
+    }
+    thread_ = std::thread([this] { run(); });
+}
+
+// Destructor implementation
+Watcher::~Watcher() {
+    if (thread_.joinable()) {
+        std::uint64_t const one = 1;
+        if (::write(wake_, &one, sizeof(one)) == sizeof(one))
+            thread_.join();
+        else
+            thread_.detach();
+    }
+    if (fd_ >= 0)
+        ::close(fd_);
+    if (wake_ >= 0)
+        ::close(wake_);
+}
+
+void Watcher::watch_directory(const std::string& dir) {
+    add(normalize(dir), false);
+}
+
+void Watcher::watch_parent(const std::string& path) {
+    auto const slash = path.rfind('/');
+    watch_directory(slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash));
+}
+
+std::size_t Watcher::watch_tree(const std::string& root) {
+    if (!active())
+        return 0;
+
+    std::size_t count = add(normalize(root), true) ? 1 : 0;
+    std::error_code ec;
+    std::filesystem::recursive_directory_iterator it(
+        root, std::filesystem::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (it->is_directory(ec) && !it->is_symlink(ec) && add(normalize(it->path().string()), true))
+            ++count;
+    }
+    return count;
+}
+
+void Watcher::subscribe(Callback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscribers_.push_back(std::move(callback));
+}
+
+bool Watcher::active() const {
+    return fd_ >= 0 && wake_ >= 0;
+}
+
+// Returns true if the directory is now watched as part of a tree
+bool Watcher::add(const std::string& dir, bool tree) {
+    if (!active())
+        return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (watched_.count(dir) && !tree)
+        return false;
+    int const wd = ::inotify_add_watch(fd_, dir.c_str(), watch_mask | IN_ONLYDIR);
+    if (wd < 0) {
+        Log::get().log(Level::WARN, "[Watcher] Could not watch: " + dir);
+        return false;
+    }
+    // Adding a watch twice returns the same descriptor; a tree flag sticks
+    auto& directory = directories_[wd];
+    bool const added = tree && !directory.tree;
+    directory.path = dir;
+    directory.tree = directory.tree || tree;
+    watched_.insert(dir);
+    return added;
+}
+
+void Watcher::run() {
+    alignas(struct inotify_event) char buffer[16 * 1024];
+    pollfd fds[2] = {{fd_, POLLIN, 0}, {wake_, POLLIN, 0}};
+
+    for (;;) {
+        if (::poll(fds, 2, -1) < 0)
+            continue;
+        if (fds[1].revents)
+            return;
+
+        auto const n = ::read(fd_, buffer, sizeof(buffer));
+        if (n <= 0)
+            continue;
+
+        for (char* p = buffer; p < buffer + n;) {
+            auto const* event = reinterpret_cast<struct inotify_event const*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                Log::get().log(Level::WARN, "[Watcher] Event queue overflowed");
+                notify({}, false);
+                continue;
+            }
+
+            std::string path;
+            bool tree = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = directories_.find(event->wd);
+                if (it == directories_.end())
+                    continue;
+                path = it->second.path;
+                tree = it->second.tree;
+                if (event->mask & (IN_IGNORED | IN_MOVE_SELF)) {
+                    // The directory itself went away or now has another
+                    // name; if it moved within a tree its new parent
+                    // reports it
+                    if (event->mask & IN_MOVE_SELF)
+                        ::inotify_rm_watch(fd_, event->wd);
+                    watched_.erase(path);
+                    directories_.erase(it);
+                    continue;
+                }
+            }
+            if (event->len > 0) {
+                if (path.back() != '/')
+                    path += '/';
+                path += event->name;
+            }
+
+            // Entries below a directory that moved or vanished are cached
+            // under paths that no longer exist
+            bool const directory = event->mask & IN_ISDIR;
+            if (directory && (event->mask & (IN_MOVED_FROM | IN_DELETE))) {
+                notify({}, false);
+                continue;
+            }
+
+            // A directory created or moved into a tree joins it, and files
+            // already inside it are reported
+            if (directory && tree && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                watch_tree(path);
+                std::error_code ec;
+                std::filesystem::recursive_directory_iterator it(
+                    path, std::filesystem::directory_options::skip_permission_denied, ec);
+                for (; !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+                    if (it->is_regular_file(ec))
+                        notify(it->path().string(), true);
+                }
+                continue;
+            }
+
+            notify(path, (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0);
+        }
+    }
+}
+
+void Watcher::notify(const std::string& path, bool complete) {
+    std::vector<Callback> subscribers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        subscribers = subscribers_;
+    }
+    for (auto const& callback : subscribers)
+        callback(path, complete);
+}
@@ -1,14 +1,17 @@
 #include "../include/session.hpp"
 #include "../include/http_tools.hpp"
+#include "../include/response_headers.hpp"
+#include "../include/sse_session.hpp"
 #include "../include/utils.hpp"
 
 session::session(
     tcp::socket&& socket,
-    ssl::context& ctx,
+    std::shared_ptr<ssl::context> ctx,
     std::shared_ptr<std::string const> const& doc_root,
     std::shared_ptr<Application> app)
 
-    : stream_(std::move(socket), ctx)
+    : ctx_(std::move(ctx))
+    , stream_(std::move(socket), *ctx_)
     , doc_root_(doc_root)
     , app_(app)
 {
@@ -65,6 +68,43 @@ void session::on_read(beast::error_code ec, std::size_t bytes_transferred)
     if(ec)
         return fail(ec, "read");
 
+    // While draining, tell keep-alive clients to reconnect elsewhere
+    if(app_->draining())
+        req_.keep_alive(false);
+
+    if(auto res = intercept_request(req_))
+    {
+        app_->request_started();
+        return send_response(std::move(*res));
+    }
+
+    // Event streams outlive the request/response cycle, so the stream is
+    // handed over to an sse_session and this session ends here.
+    if(req_.method() == http::verb::get &&
+       app_->get_broadcast()->has_channel(req_.target()))
+    {
+        // The event stream never reads again, so a request pipelined
+        // behind this one, already in buffer_, could never be answered
+        if(buffer_.size() != 0)
+        {
+            app_->request_started();
+            http::response<http::string_body> res{http::status::bad_request, req_.version()};
+            response_headers::stamp(res);
+            res.set(http::field::content_type, "application/json");
+            res.body() = R"({"error": "Request pipelined behind an event stream"})";
+            res.keep_alive(false);
+            decorate_response(res.base(), req_);
+            res.prepare_payload();
+            return send_response(std::move(res));
+        }
+
+        std::make_shared<sse_session>(
+            std::move(stream_),
+            app_->get_broadcast())->run(req_);
+        return;
+    }
+
+    app_->request_started();
     send_response(
         handle_request(*doc_root_, std::move(req_), app_));
 }
@@ -84,6 +124,8 @@ void session::on_write(bool keep_alive, beast::error_code ec, std::size_t bytes_
 {
     boost::ignore_unused(bytes_transferred);
 
+    app_->request_finished();
+
     if(ec)
         return fail(ec, "write");
 
@@ -0,0 +1,137 @@
+#include "../include/sni.hpp"
+#include "../include/services/log.hpp"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+std::string lowercase(beast::string_view s)
+{
+    std::string out(s);
+    std::transform(out.begin(), out.end(), out.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return out;
+}
+
+// ECDSA suites first, honoured because the server's order takes precedence
+char const* const cipher_list =
+    "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-ECDSA-CHACHA20-POLY1305:"
+    "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES128-GCM-SHA256:"
+    "ECDHE-RSA-CHACHA20-POLY1305:ECDHE-RSA-AES256-GCM-SHA384";
+
+std::shared_ptr<boost::asio::ssl::context> make_context(std::string const& password)
+{
+    auto ctx = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tlsv12);
+    ctx->set_password_callback(
+        [password](std::size_t, boost::asio::ssl::context_base::password_purpose)
+        {
+            return password;
+        });
+    ctx->set_options(
+        boost::asio::ssl::context::default_workarounds |
+        boost::asio::ssl::context::no_sslv2 |
+        boost::asio::ssl::context::single_dh_use |
+        SSL_OP_CIPHER_SERVER_PREFERENCE);
+    if(::SSL_CTX_set_cipher_list(ctx->native_handle(), cipher_list) != 1)
+        throw std::runtime_error("Could not set cipher list");
+    return ctx;
+}
+
+void add_certificate(boost::asio::ssl::context& ctx, std::string const& cert, std::string const& key)
+{
+    // The native call keeps a separate chain per key type, whereas
+    // context::use_certificate_chain shares one extra chain between them
+    if(::SSL_CTX_use_certificate_chain_file(ctx.native_handle(), cert.c_str()) != 1)
+        throw std::runtime_error("Could not load certificate chain: " + cert);
+    ctx.use_private_key_file(key, boost::asio::ssl::context::pem);
+}
+
+} // namespace
+
+std::shared_ptr<sni_map> sni_map::load(std::string const& path, std::string const& password)
+{
+    std::ifstream file(path);
+    if(! file.is_open())
+        throw std::runtime_error("Could not open file: " + path);
+
+    auto map = std::make_shared<sni_map>();
+    std::string line;
+    while(std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string host, cert, key;
+        if(! (fields >> host) || host[0] == '#')
+            continue;
+        if(! (fields >> cert >> key))
+            throw std::runtime_error("Malformed line in " + path + ": " + line);
+
+        host = lowercase(host);
+        bool const wildcard = host.rfind("*.", 0) == 0;
+        if(wildcard)
+            host.erase(0, 2);
+
+        auto& ctx = (wildcard ? map->wildcard_ : map->exact_)[host];
+        if(! ctx)
+            ctx = make_context(password);
+        add_certificate(*ctx, cert, key);
+    }
+
+    Log::get().log(Level::INFO, "[sni_map] Loaded " + std::to_string(map->size()) + " virtual host(s) from " + path);
+    return map;
+}
+
+boost::asio::ssl::context* sni_map::find(beast::string_view host) const
+{
+    auto const name = lowercase(host);
+    auto it = exact_.find(name);
+    if(it != exact_.end())
+        return it->second.get();
+
+    // A wildcard covers exactly one label
+    auto const dot = name.find('.');
+    if(dot == std::string::npos)
+        return nullptr;
+    it = wildcard_.find(name.substr(dot + 1));
+    if(it != wildcard_.end())
+        return it->second.get();
+    return nullptr;
+}
+
+void sni_map::attach(boost::asio::ssl::context& ctx) const
+{
+    ::SSL_CTX_set_tlsext_servername_callback(ctx.native_handle(), &sni_map::on_servername);
+    ::SSL_CTX_set_tlsext_servername_arg(ctx.native_handle(), const_cast<sni_map*>(this));
+}
+
+std::size_t sni_map::size() const
+{
+    return exact_.size() + wildcard_.size();
+}
+
+int sni_map::on_servername(SSL* ssl, int* alert, void* arg)
+{
+    char const* name = ::SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+    if(! name)
+        return SSL_TLSEXT_ERR_NOACK;
+
+    auto const* map = static_cast<sni_map const*>(arg);
+    auto* ctx = map->find(name);
+    if(! ctx)
+        return SSL_TLSEXT_ERR_OK;
+
+    // SSL_set_SSL_CTX swaps the certificates only; the options and cipher
+    // list were copied from the default context when the connection was
+    // created, so take the virtual host's here
+    ::SSL_set_SSL_CTX(ssl, ctx->native_handle());
+    auto const options = ::SSL_CTX_get_options(ctx->native_handle());
+    ::SSL_clear_options(ssl, ::SSL_get_options(ssl) & ~options);
+    ::SSL_set_options(ssl, options);
+    if(::SSL_set_cipher_list(ssl, cipher_list) != 1)
+    {
+        *alert = SSL_AD_INTERNAL_ERROR;
+        return SSL_TLSEXT_ERR_ALERT_FATAL;
+    }
+    return SSL_TLSEXT_ERR_OK;
+}
@@ -0,0 +1,181 @@
+#include "../include/sse_session.hpp"
+#include "../include/utils.hpp"
+#include "../include/response_headers.hpp"
+#include "../include/services/log.hpp"
+
+sse_session::sse_session(
+    beast::ssl_stream<beast::tcp_stream>&& stream,
+    std::shared_ptr<Broadcast> broadcast)
+
+    : stream_(std::move(stream))
+    , broadcast_(std::move(broadcast))
+    , sr_(res_)
+    , ping_(stream_.get_executor())
+{
+}
+
+void sse_session::prepare_header()
+{
+    response_headers::stamp(res_);
+    res_.set(http::field::content_type, "text/event-stream");
+    res_.set(http::field::cache_control, "no-cache");
+}
+
+void sse_session::start(std::string target)
+{
+    // After the middleware, which must not turn the stream into a
+    // fixed-length response
+    res_.chunked(true);
+
+    broadcast_->subscribe(target, weak_from_this());
+    Log::get().log(Level::INFO, "[sse_session] Streaming events for: " + target);
+
+    beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(30));
+
+    http::async_write_header(stream_, sr_,
+        beast::bind_front_handler(
+            &sse_session::on_header,
+            shared_from_this()));
+}
+
+void sse_session::on_header(beast::error_code ec, std::size_t bytes_transferred)
+{
+    boost::ignore_unused(bytes_transferred);
+
+    if(ec)
+        return fail(ec, "sse header");
+
+    if(closing_)
+        return do_close();
+
+    do_ping();
+    do_write();
+}
+
+void sse_session::do_ping()
+{
+    // A comment line keeps intermediaries from timing out idle streams
+    static Broadcast::Buffer const ping =
+        std::make_shared<std::string const>(": ping\n\n");
+
+    ping_.expires_after(std::chrono::seconds(15));
+    ping_.async_wait(
+        [self = shared_from_this()](beast::error_code ec)
+        {
+            if(ec || self->closing_)
+                return;
+            self->push(ping);
+            self->do_ping();
+        });
+}
+
+bool sse_session::deliver(Broadcast::Buffer const& event)
+{
+    // Called from the publishing thread, so only the atomic counter is
+    // touched here; the queue itself belongs to the strand.
+    if(pending_.fetch_add(1) >= broadcast_->max_pending())
+    {
+        pending_.fetch_sub(1);
+        return false;
+    }
+
+    net::post(
+        stream_.get_executor(),
+        [self = shared_from_this(), event]
+        {
+            self->queue_.push_back(event);
+            self->do_write();
+        });
+    return true;
+}
+
+void sse_session::push(Broadcast::Buffer event)
+{
+    pending_.fetch_add(1);
+    queue_.push_back(std::move(event));
+    do_write();
+}
+
+void sse_session::do_write()
+{
+    if(writing_ || closing_ || queue_.empty() || ! sr_.is_header_done())
+        return;
+
+    writing_ = true;
+    beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(30));
+
+    net::async_write(
+        stream_,
+        http::make_chunk(net::buffer(*queue_.front())),
+        beast::bind_front_handler(
+            &sse_session::on_write,
+            shared_from_this()));
+}
+
+void sse_session::on_write(beast::error_code ec, std::size_t bytes_transferred)
+{
+    boost::ignore_unused(bytes_transferred);
+
+    writing_ = false;
+    queue_.pop_front();
+    pending_.fetch_sub(1);
+
+    if(ec)
+    {
+        closing_ = true;
+        ping_.cancel();
+        return fail(ec, "sse write");
+    }
+
+    if(closing_)
+        return do_close();
+
+    do_write();
+}
+
+void sse_session::close()
+{
+    net::post(
+        stream_.get_executor(),
+        [self = shared_from_this()]
+        {
+            if(self->closing_)
+                return;
+            self->closing_ = true;
+            self->ping_.cancel();
+            if(! self->writing_ && self->sr_.is_header_done())
+                self->do_close();
+        });
+}
+
+void sse_session::do_close()
+{
+    queue_.clear();
+    beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(30));
+
+    net::async_write(
+        stream_,
+        http::make_chunk_last(),
+        beast::bind_front_handler(
+            &sse_session::on_close,
+            shared_from_this()));
+}
+
+void sse_session::on_close(beast::error_code ec, std::size_t bytes_transferred)
+{
+    boost::ignore_unused(bytes_transferred);
+
+    if(ec)
+        return fail(ec, "sse close");
+
+    stream_.async_shutdown(
+        beast::bind_front_handler(
+            &sse_session::on_shutdown,
+            shared_from_this()));
+}
+
+void sse_session::on_shutdown(beast::error_code ec)
+{
+    if(ec)
+        return fail(ec, "shutdown");
+}
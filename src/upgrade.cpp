@@ -0,0 +1,184 @@
+#include "../include/upgrade.hpp"
+#include "../include/services/log.hpp"
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <string>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char** environ;
+
+namespace {
+
+// Environment variables used to pass descriptors across exec
+char const* const listen_fd_env = "LISTEN_FD";
+char const* const ready_fd_env = "UPGRADE_READY_FD";
+
+// Path of the binary to exec, set at startup. /proc/self/exe would name
+// the inode already running, so a replaced binary would never be picked up.
+std::string executable;
+
+int fd_from_env(char const* name)
+{
+    char const* value = std::getenv(name);
+    if(! value)
+        return -1;
+    unsetenv(name);
+    char* end = nullptr;
+    long const fd = std::strtol(value, &end, 10);
+    if(end == value || *end != '\0' || fd < 0)
+        return -1;
+    return static_cast<int>(fd);
+}
+
+// Descriptors above stderr open in this process, except those in keep
+std::vector<int> open_descriptors(int keep1, int keep2)
+{
+    std::vector<int> fds;
+    DIR* dir = ::opendir("/proc/self/fd");
+    if(! dir)
+        return fds;
+    while(dirent* entry = ::readdir(dir))
+    {
+        int const fd = std::atoi(entry->d_name);
+        if(fd > 2 && fd != ::dirfd(dir) && fd != keep1 && fd != keep2)
+            fds.push_back(fd);
+    }
+    ::closedir(dir);
+    return fds;
+}
+
+// Mark every descriptor from 3 up close-on-exec in one call, where the
+// kernel supports it
+bool cloexec_from_3()
+{
+#if defined(SYS_close_range) && defined(CLOSE_RANGE_CLOEXEC)
+    return ::syscall(SYS_close_range, 3U, ~0U, CLOSE_RANGE_CLOEXEC) == 0;
+#else
+    return false;
+#endif
+}
+
+} // namespace
+
+void remember_executable()
+{
+    if(char const* path = std::getenv("UPGRADE_BINARY"))
+    {
+        executable = path;
+        return;
+    }
+    char buf[4096];
+    auto const n = ::readlink("/proc/self/exe", buf, sizeof(buf));
+    if(n <= 0 || static_cast<std::size_t>(n) >= sizeof(buf))
+    {
+        Log::get().log(Level::WARN, "[upgrade] Cannot resolve the executable; upgrades are disabled");
+        return;
+    }
+    executable.assign(buf, static_cast<std::size_t>(n));
+}
+
+int inherited_listen_fd()
+{
+    int const fd = fd_from_env(listen_fd_env);
+    if(fd >= 0)
+        Log::get().log(Level::INFO, "[upgrade] Inherited listening socket fd " + std::to_string(fd));
+    return fd;
+}
+
+void notify_upgrade_ready()
+{
+    int const fd = fd_from_env(ready_fd_env);
+    if(fd < 0)
+        return;
+    char const byte = 1;
+    if(::write(fd, &byte, 1) != 1)
+        Log::get().log(Level::WARN, "[upgrade] Could not notify previous process");
+    ::close(fd);
+}
+
+void start_upgrade(
+    boost::asio::io_context& ioc,
+    int listen_fd,
+    char* argv[],
+    std::function<void(bool)> on_ready)
+{
+    if(executable.empty())
+    {
+        Log::get().log(Level::ERROR, "[upgrade] No executable to upgrade to");
+        return on_ready(false);
+    }
+
+    int ready[2];
+    if(::pipe2(ready, O_CLOEXEC) != 0)
+    {
+        Log::get().log(Level::ERROR, "[upgrade] pipe failed");
+        return on_ready(false);
+    }
+
+    // Everything the child needs is prepared before fork so that only
+    // async-signal-safe calls happen between fork and exec
+    std::string const listen_value = std::string(listen_fd_env) + "=" + std::to_string(listen_fd);
+    std::string const ready_value = std::string(ready_fd_env) + "=" + std::to_string(ready[1]);
+    auto const names = [](char const* entry, char const* name)
+    {
+        auto const n = std::strlen(name);
+        return std::strncmp(entry, name, n) == 0 && entry[n] == '=';
+    };
+    std::vector<char*> envp;
+    for(char** e = environ; *e; ++e)
+        if(! names(*e, listen_fd_env) && ! names(*e, ready_fd_env))
+            envp.push_back(*e);
+    envp.push_back(const_cast<char*>(listen_value.c_str()));
+    envp.push_back(const_cast<char*>(ready_value.c_str()));
+    envp.push_back(nullptr);
+
+    // Only needed on kernels without close_range
+    std::vector<int> const inherited = open_descriptors(listen_fd, ready[1]);
+
+    pid_t const pid = ::fork();
+    if(pid < 0)
+    {
+        ::close(ready[0]);
+        ::close(ready[1]);
+        Log::get().log(Level::ERROR, "[upgrade] fork failed");
+        return on_ready(false);
+    }
+
+    if(pid == 0)
+    {
+        // Connections owned by this process must not stay open in the
+        // child, or clients would never see them close
+        if(! cloexec_from_3())
+            for(int fd : inherited)
+                ::close(fd);
+        ::fcntl(listen_fd, F_SETFD, 0);
+        ::fcntl(ready[1], F_SETFD, 0);
+        ::execve(executable.c_str(), argv, envp.data());
+        ::_exit(127);
+    }
+
+    ::close(ready[1]);
+    Log::get().log(Level::INFO, "[upgrade] Started new process " + std::to_string(pid));
+
+    // The child writes one byte once it accepts; EOF means it died first
+    auto pipe = std::make_shared<boost::asio::posix::stream_descriptor>(ioc, ready[0]);
+    auto byte = std::make_shared<char>(0);
+    pipe->async_read_some(
+        boost::asio::buffer(byte.get(), 1),
+        [pipe, byte, pid, on_ready](boost::system::error_code ec, std::size_t n)
+        {
+            bool const ok = ! ec && n == 1;
+            if(! ok)
+            {
+                Log::get().log(Level::ERROR, "[upgrade] New process " + std::to_string(pid) + " failed to start");
+                ::waitpid(pid, nullptr, WNOHANG);
+            }
+            on_ready(ok);
+        });
+}
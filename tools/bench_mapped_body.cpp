@@ -0,0 +1,145 @@
+// Compares writing a static file as an http::file_body, as the server did,
+// with writing it from a mapped_file through a shared_body.
+//
+//     g++ -std=c++17 -O2 -Iinclude tools/bench_mapped_body.cpp src/mapped_file.cpp src/services/log.cpp -lssl -lcrypto -lpthread -o bench_mapped_body
+//     bench_mapped_body /tmp/bench [max-size]
+//
+// Files of 1KB to max-size (default 1GB), growing 16 times each step, are
+// created in the directory. Each is written as complete responses into a
+// local socket pair drained by another thread, opening the file afresh for
+// every response as a request would. No live mapping is kept between
+// responses, so each mapped response pays for its own mmap and munmap.
+#include "../include/beast.hpp"
+#include "../include/mapped_file.hpp"
+#include "../include/shared_body.hpp"
+#include <boost/asio/local/connect_pair.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+using stream = net::local::stream_protocol::socket;
+
+static void make_file(std::string const& path, std::uint64_t size)
+{
+    struct stat st;
+    if(::stat(path.c_str(), &st) == 0 && static_cast<std::uint64_t>(st.st_size) == size)
+        return;
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    std::vector<char> chunk(1 << 20);
+    for(std::size_t i = 0; i < chunk.size(); ++i)
+        chunk[i] = static_cast<char>('a' + i % 26);
+    for(std::uint64_t left = size; left > 0;)
+    {
+        auto const n = static_cast<std::size_t>(std::min<std::uint64_t>(left, chunk.size()));
+        out.write(chunk.data(), n);
+        left -= n;
+    }
+}
+
+static void write_file_body(stream& s, std::string const& path)
+{
+    beast::error_code ec;
+    http::response<http::file_body> res{http::status::ok, 11};
+    res.body().open(path.c_str(), beast::file_mode::scan, ec);
+    if(ec)
+        throw beast::system_error{ec};
+    res.prepare_payload();
+    http::write(s, res);
+}
+
+static void write_mapped_body(stream& s, std::string const& path)
+{
+    struct stat st;
+    if(::stat(path.c_str(), &st) != 0)
+        throw std::runtime_error("Cannot stat: " + path);
+    auto mapped = mapped_file::open(path, st);
+    if(! mapped)
+        throw std::runtime_error("Cannot map: " + path);
+    http::response<shared_body> res{
+        std::piecewise_construct,
+        std::make_tuple(shared_body::value_type{mapped, mapped->data(), mapped->size()}),
+        std::make_tuple(http::status::ok, 11)};
+    res.prepare_payload();
+    http::write(s, res);
+}
+
+// Seconds taken to write the file n times and for the reader to drain it
+template<class Write>
+static double run(std::string const& path, int n, Write write)
+{
+    net::io_context ioc;
+    stream writer(ioc), reader(ioc);
+    net::local::connect_pair(writer, reader);
+
+    auto const start = std::chrono::steady_clock::now();
+    std::thread drain([&reader] {
+        std::vector<char> buffer(256 * 1024);
+        beast::error_code ec;
+        while(! ec)
+            reader.read_some(net::buffer(buffer), ec);
+    });
+    for(int i = 0; i < n; ++i)
+        write(writer, path);
+    writer.shutdown(stream::shutdown_send);
+    drain.join();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string size_name(std::uint64_t size)
+{
+    char const* units[] = {"B", "KB", "MB", "GB"};
+    int unit = 0;
+    while(size >= 1024 && size % 1024 == 0 && unit < 3)
+    {
+        size /= 1024;
+        ++unit;
+    }
+    return std::to_string(size) + units[unit];
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2 || argc > 3)
+    {
+        std::cerr << "Usage: bench_mapped_body <dir> [max-size]\n";
+        return EXIT_FAILURE;
+    }
+    std::string const dir = argv[1];
+    std::uint64_t const max_size = argc == 3 ? std::strtoull(argv[2], nullptr, 10) : (1ull << 30);
+
+    try
+    {
+        fs::create_directories(dir);
+        std::printf("%8s %8s %14s %14s\n", "size", "writes", "file_body MB/s", "mapped MB/s");
+        for(std::uint64_t size = 1024; size <= max_size; size *= 16)
+        {
+            auto const path = (fs::path(dir) / ("bench-" + size_name(size))).string();
+            make_file(path, size);
+
+            // About 4GB per run, from 3 to 100000 responses
+            int const n = static_cast<int>(std::clamp<std::uint64_t>((4ull << 30) / size, 3, 100000));
+            run(path, 1, write_file_body); // warm the page cache
+
+            double const file = run(path, n, write_file_body);
+            double const mapped = run(path, n, write_mapped_body);
+            double const mb = static_cast<double>(size) * n / (1024 * 1024);
+            std::printf("%8s %8d %14.0f %14.0f\n", size_name(size).c_str(), n, mb / file, mb / mapped);
+        }
+    }
+    catch(std::exception const& e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
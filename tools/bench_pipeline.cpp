@@ -0,0 +1,112 @@
+// Times a request and its response passing through a pipeline<> of eight
+// stages, against the same stages called by hand and through virtual
+// calls, as a runtime chain would.
+//
+//     g++ -std=c++17 -O2 -Iinclude tools/bench_pipeline.cpp -lssl -lcrypto -lpthread -o bench_pipeline
+//     bench_pipeline [requests]
+//
+// Half the stages count requests by method and response bytes, the
+// other half define no hooks. Requests cycle through a few targets.
+#include "../include/beast.hpp"
+#include "../include/middleware.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using request = http::request<http::string_body>;
+using fields = http::fields;
+
+struct counting
+{
+    std::size_t gets = 0;
+    std::size_t bytes = 0;
+
+    boost::optional<http::response<http::string_body>> on_request(request& req)
+    {
+        gets += req.method() == http::verb::get;
+        bytes += req.target().size();
+        return boost::none;
+    }
+
+    void on_response(request const& req, http::header<false, fields>& res)
+    {
+        bytes += res.result_int() + req.target().size();
+    }
+};
+
+struct empty
+{
+};
+
+// The same work behind a virtual call per hook
+struct stage
+{
+    virtual ~stage() = default;
+    virtual boost::optional<http::response<http::string_body>> on_request(request&) { return boost::none; }
+    virtual void on_response(request const&, http::header<false, fields>&) {}
+};
+
+struct virtual_counting : stage
+{
+    counting c;
+    boost::optional<http::response<http::string_body>> on_request(request& req) override { return c.on_request(req); }
+    void on_response(request const& req, http::header<false, fields>& res) override { c.on_response(req, res); }
+};
+
+template<class Handle>
+static void run(char const* name, long requests, Handle handle)
+{
+    std::vector<request> reqs;
+    for(auto target : {"/", "/index.html", "/api/items?page=2", "/static/app.js"})
+        reqs.emplace_back(http::verb::get, target, 11);
+    http::response<http::string_body> res{http::status::ok, 11};
+
+    auto const start = std::chrono::steady_clock::now();
+    for(long i = 0; i < requests; ++i)
+        handle(reqs[i % reqs.size()], res.base());
+    auto const ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%-10s %6.2f ns/request\n", name, ns / requests);
+}
+
+int main(int argc, char* argv[])
+{
+    long const requests = argc > 1 ? std::atol(argv[1]) : 10000000;
+
+    pipeline<counting, empty, counting, empty, counting, empty, counting, empty> chain;
+    run("pipeline", requests, [&](request& req, http::header<false, fields>& res) {
+        if(auto answer = chain.on_request(req))
+            return;
+        chain.on_response(req, res);
+    });
+
+    counting a, b, c, d;
+    run("by hand", requests, [&](request& req, http::header<false, fields>& res) {
+        if(a.on_request(req) || b.on_request(req) || c.on_request(req) || d.on_request(req))
+            return;
+        d.on_response(req, res);
+        c.on_response(req, res);
+        b.on_response(req, res);
+        a.on_response(req, res);
+    });
+
+    std::vector<std::unique_ptr<stage>> stages;
+    for(int i = 0; i < 4; ++i)
+    {
+        stages.push_back(std::make_unique<virtual_counting>());
+        stages.push_back(std::make_unique<stage>());
+    }
+    run("virtual", requests, [&](request& req, http::header<false, fields>& res) {
+        for(auto& s : stages)
+            if(s->on_request(req))
+                return;
+        for(auto it = stages.rbegin(); it != stages.rend(); ++it)
+            (*it)->on_response(req, res);
+    });
+
+    // Printed, so the counting is not optimized away
+    auto const& first = chain.get<0>();
+    std::printf("(%zu %zu %zu %zu)\n", first.gets, first.bytes, a.gets, a.bytes);
+    return EXIT_SUCCESS;
+}
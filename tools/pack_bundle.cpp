@@ -0,0 +1,204 @@
+// Packs a document root into one asset bundle for the server to map with
+// BUNDLE=<file>. See include/asset_bundle.hpp for the format.
+//
+//     g++ -std=c++17 -Iinclude tools/pack_bundle.cpp src/compress.cpp -lssl -lcrypto -lz -o pack_bundle
+//     pack_bundle www site.bundle
+//
+// Content types come from the built-in table. A precompressed .gz sibling
+// is used as the gzip variant of its file; otherwise compressible files
+// are gzipped here, once, at the highest level. The output is written
+// next to the target and renamed over it, so a running server switches
+// to the new bundle in one step.
+#include "../include/asset_bundle.hpp"
+#include "../include/compress.hpp"
+#include "../include/mime_table.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+struct packed_file
+{
+    std::string path;
+    std::string content_type;
+    std::string etag;
+    std::string gzip_etag;
+    std::string last_modified;
+    std::string data;
+    std::string gzip;
+    std::int64_t mtime;
+};
+
+static std::string read_file(fs::path const& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Same rules as mime_type() in http_tools.cpp, less the runtime overrides
+static std::string content_type_of(std::string const& path)
+{
+    auto const dot = path.rfind('.');
+    if(dot == std::string::npos)
+        return "application/text";
+    auto const type = mime_table::lookup(std::string_view(path).substr(dot + 1));
+    return type.empty() ? "application/text" : std::string(type);
+}
+
+// Content hash, so rebuilding an unchanged file keeps its tag
+static std::string content_etag(std::string const& data, char const* suffix)
+{
+    std::uint64_t h = 14695981039346656037ull;
+    for(unsigned char c : data)
+    {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    char buf[48];
+    int const n = std::snprintf(buf, sizeof(buf), "\"%016llx%s\"", static_cast<unsigned long long>(h), suffix);
+    return std::string(buf, n);
+}
+
+static std::string http_date(std::int64_t mtime)
+{
+    std::time_t const t = static_cast<std::time_t>(mtime / 1000000000);
+    std::tm tm;
+    gmtime_r(&t, &tm);
+    char buf[32];
+    auto const n = std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return std::string(buf, n);
+}
+
+static std::int64_t mtime_of(fs::path const& path)
+{
+    // file_time_type has no portable epoch in C++17; stat gives nanoseconds
+    struct stat st;
+    if(::stat(path.c_str(), &st) != 0)
+        return 0;
+    return static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+static bool is_sibling(fs::path const& path, char const* extension)
+{
+    if(path.extension() != extension)
+        return false;
+    auto source = path;
+    source.replace_extension();
+    std::error_code ec;
+    return fs::is_regular_file(source, ec);
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc != 3)
+    {
+        std::cerr <<
+            "Usage: pack_bundle <doc_root> <output>\n" <<
+            "Example:\n" <<
+            "    pack_bundle www site.bundle\n";
+        return EXIT_FAILURE;
+    }
+    fs::path const root = argv[1];
+    std::string const output = argv[2];
+
+    std::vector<packed_file> files;
+    std::error_code ec;
+    for(fs::recursive_directory_iterator it(root, ec), end; ! ec && it != end; it.increment(ec))
+    {
+        if(! it->is_regular_file(ec))
+            continue;
+        auto const& source = it->path();
+
+        // Precompressed siblings are folded into their source's record
+        if(is_sibling(source, ".gz") || is_sibling(source, ".br"))
+            continue;
+
+        packed_file file;
+        file.path = "/" + source.lexically_relative(root).generic_string();
+        file.content_type = content_type_of(file.path);
+        file.data = read_file(source);
+        file.mtime = mtime_of(source);
+        file.etag = content_etag(file.data, "");
+        file.last_modified = http_date(file.mtime);
+
+        auto gz = source;
+        gz += ".gz";
+        if(fs::is_regular_file(gz, ec))
+            file.gzip = read_file(gz);
+        else if(file.data.size() >= compress_min_size && compressible(file.content_type))
+            file.gzip = gzip_compress(file.data, 9);
+        if(file.gzip.size() >= file.data.size())
+            file.gzip.clear();
+        if(! file.gzip.empty())
+            file.gzip_etag = content_etag(file.data, "-gzip");
+
+        files.push_back(std::move(file));
+    }
+    if(ec)
+    {
+        std::cerr << "Cannot read " << root << ": " << ec.message() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::sort(files.begin(), files.end(),
+        [](packed_file const& a, packed_file const& b) { return a.path < b.path; });
+
+    // Lay out the records, then every string and content after them
+    bundle_format::header header;
+    std::copy(std::begin(bundle_format::magic), std::end(bundle_format::magic), header.magic);
+    header.count = files.size();
+
+    std::string area;
+    std::uint64_t const base = sizeof(header) + files.size() * sizeof(bundle_format::record);
+    auto const append = [&area, base](std::string const& s)
+    {
+        bundle_format::span span{base + area.size(), s.size()};
+        area += s;
+        return span;
+    };
+
+    std::vector<bundle_format::record> records;
+    records.reserve(files.size());
+    for(auto const& file : files)
+    {
+        bundle_format::record r;
+        r.path = append(file.path);
+        r.content_type = append(file.content_type);
+        r.etag = append(file.etag);
+        r.gzip_etag = append(file.gzip_etag);
+        r.last_modified = append(file.last_modified);
+        r.data = append(file.data);
+        r.gzip = append(file.gzip);
+        r.mtime = file.mtime;
+        records.push_back(r);
+    }
+
+    std::string const temporary = output + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        out.write(reinterpret_cast<char const*>(records.data()), records.size() * sizeof(bundle_format::record));
+        out.write(area.data(), area.size());
+        if(! out)
+        {
+            std::cerr << "Cannot write " << temporary << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if(std::rename(temporary.c_str(), output.c_str()) != 0)
+    {
+        std::cerr << "Cannot rename " << temporary << " to " << output << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Packed " << files.size() << " file(s), " << base + area.size() << " bytes, into " << output << "\n";
+    return EXIT_SUCCESS;
+}